@@ -0,0 +1,554 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	Headless benchmark for Python Processor scripts.
+
+	Runs a module's PyProcessor against synthetic or replayed data, through
+	the same marshalling as the plugin (pooled arrays, dtype conversion,
+	batched spikes and TTL events), and reports throughput, per-call
+	latency and memory. No Open Ephys GUI is needed.
+
+	python_benchmark --script Modules/examples/bandpass_filter.py --channels 384 --blocks 2000
+*/
+
+#include <pybind11/embed.h>
+#include <pybind11/numpy.h>
+
+#include "ArrayPool.h"
+#include "BlockRunner.h"
+#include "CallbackStats.h"
+#include "ModuleBindings.h"
+#include "NativeKernel.h"
+#include "OutputEventQueue.h"
+#include "PyCallbacks.h"
+#include "SampleConverter.h"
+#include "SpikeBatch.h"
+#include "TTLBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace py = pybind11;
+
+/** Command line settings */
+struct BenchmarkSettings
+{
+	std::string scriptPath;
+
+	/** Raw float32 samples, interleaved across channels. Empty for synthetic data */
+	std::string replayPath;
+
+	/** CallbackStats summary, as written by the plugin's save_latency option */
+	std::string csvPath;
+
+	int numChannels = 64;
+	float sampleRate = 30000.0f;
+	int blockSize = 1024;
+	int numBlocks = 1000;
+
+	/** Spikes and TTL events per second, spread evenly over the blocks */
+	double spikeRate = 0.0;
+	double ttlRate = 0.0;
+
+	/** Shape of the synthetic spike waveforms */
+	int spikeChannels = 4;
+	int spikeSamples = 40;
+
+	SampleConverter::Format format = SampleConverter::FLOAT32;
+	float int16Scale = 0.195f;
+
+	bool readOnly = false;
+
+	/** Exit with an error if the 99th percentile of process() exceeds this, in microseconds (0 = no limit) */
+	double maxP99 = 0.0;
+};
+
+/** Stands in for PythonProcessor as the processor passed to PyProcessor.__init__() */
+class BenchmarkHost
+{
+public:
+
+	void addPythonEvent(int line, bool state, int sampleOffset)
+	{
+		outputEvents.push({ (uint8_t) line, state, 0, sampleOffset });
+	}
+
+	void addPythonEvents(py::array_t<int, py::array::c_style | py::array::forcecast> lines,
+						 py::array_t<bool, py::array::c_style | py::array::forcecast> states,
+						 py::object sampleOffsets)
+	{
+		if (states.size() != lines.size())
+			throw py::value_error("lines and states must have the same length");
+
+		auto offsets = py::array_t<int, py::array::c_style | py::array::forcecast>::ensure(sampleOffsets);
+		const int* offsetData = nullptr;
+
+		if (!sampleOffsets.is_none())
+		{
+			if (!offsets || offsets.size() != lines.size())
+				throw py::value_error("sample_offsets must be integers, with one per event");
+
+			offsetData = offsets.data();
+		}
+
+		for (py::ssize_t i = 0; i < lines.size(); ++i)
+			outputEvents.push({ (uint8_t) lines.data()[i], states.data()[i], 0, offsetData != nullptr ? offsetData[i] : 0 });
+	}
+
+	void registerNativeProcess(py::object function, const std::string& signature)
+	{
+		setNativeKernel(nativeKernel, function, signature);
+		nativeKernelOwner = function.is_none() ? py::object() : function;
+	}
+
+	OutputEventQueue outputEvents;
+
+	NativeKernel nativeKernel;
+	py::object nativeKernelOwner;
+};
+
+PYBIND11_EMBEDDED_MODULE(oe_pyprocessor, module)
+{
+	py::class_<BenchmarkHost> (module, "PythonProcessor")
+		.def("add_python_event", &BenchmarkHost::addPythonEvent,
+			 py::arg("line"), py::arg("state"), py::arg("sample_offset") = 0)
+		.def("add_python_events", &BenchmarkHost::addPythonEvents,
+			 py::arg("lines"), py::arg("states"), py::arg("sample_offsets") = py::none())
+		.def("register_native_process", &BenchmarkHost::registerNativeProcess,
+			 py::arg("func"), py::arg("signature") = "void(float**, int32, int32)");
+
+	bindNativeTypes(module);
+}
+
+static void printUsage()
+{
+	std::printf("Usage: python_benchmark --script <module.py> [options]\n"
+				"  --channels <n>        channels per block (64)\n"
+				"  --sample-rate <hz>    sample rate (30000)\n"
+				"  --block-size <n>      samples per block (1024)\n"
+				"  --blocks <n>          number of blocks to process (1000)\n"
+				"  --spike-rate <hz>     spikes per second (0)\n"
+				"  --ttl-rate <hz>       TTL events per second (0)\n"
+				"  --dtype <type>        float32, float16 or int16 (float32)\n"
+				"  --int16-scale <x>     value of one int16 step (0.195)\n"
+				"  --read-only           pass read-only data and skip the write back\n"
+				"  --replay <file>       raw float32 samples interleaved across channels, looped\n"
+				"  --csv <file>          write the latency summary to a CSV file\n"
+				"  --max-p99 <us>        fail if the p99 process() latency exceeds this\n");
+}
+
+/** Parses the command line. Returns false on an unknown or incomplete option */
+static bool parseArguments(int argc, char** argv, BenchmarkSettings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string name = argv[i];
+
+		if (name == "--read-only")
+		{
+			settings.readOnly = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if (name == "--script") settings.scriptPath = value;
+		else if (name == "--replay") settings.replayPath = value;
+		else if (name == "--csv") settings.csvPath = value;
+		else if (name == "--channels") settings.numChannels = std::atoi(value);
+		else if (name == "--sample-rate") settings.sampleRate = (float) std::atof(value);
+		else if (name == "--block-size") settings.blockSize = std::atoi(value);
+		else if (name == "--blocks") settings.numBlocks = std::atoi(value);
+		else if (name == "--spike-rate") settings.spikeRate = std::atof(value);
+		else if (name == "--ttl-rate") settings.ttlRate = std::atof(value);
+		else if (name == "--int16-scale") settings.int16Scale = (float) std::atof(value);
+		else if (name == "--max-p99") settings.maxP99 = std::atof(value);
+		else if (name == "--dtype")
+		{
+			const std::string dtype = value;
+
+			if (dtype == "float32") settings.format = SampleConverter::FLOAT32;
+			else if (dtype == "float16") settings.format = SampleConverter::FLOAT16;
+			else if (dtype == "int16") settings.format = SampleConverter::INT16;
+			else return false;
+		}
+		else
+			return false;
+	}
+
+	return !settings.scriptPath.empty() && settings.numChannels > 0 && settings.sampleRate > 0
+		&& settings.blockSize > 0 && settings.numBlocks > 0;
+}
+
+/** Fills source with numSamples per channel, channel-major. Returns false if the replay file can't be used */
+static bool loadSource(const BenchmarkSettings& settings, std::vector<float>& source, int& numSamples)
+{
+	const int numChannels = settings.numChannels;
+
+	if (settings.replayPath.empty())
+	{
+		// Sixteen blocks of a sine per channel plus deterministic noise, looped
+		numSamples = settings.blockSize * 16;
+		source.resize((size_t) numChannels * numSamples);
+
+		const double twoPi = 6.283185307179586;
+		uint32_t noise = 12345;
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			const double frequency = 10.0 + 5.0 * c;
+
+			for (int t = 0; t < numSamples; ++t)
+			{
+				noise = noise * 1664525u + 1013904223u;
+				source[(size_t) c * numSamples + t] = (float) (100.0 * std::sin(twoPi * frequency * t / settings.sampleRate)
+															   + (noise >> 8) * (20.0 / 16777216.0) - 10.0);
+			}
+		}
+
+		return true;
+	}
+
+	std::ifstream file(settings.replayPath, std::ios::binary | std::ios::ate);
+
+	if (!file)
+		return false;
+
+	const size_t numValues = (size_t) file.tellg() / sizeof(float);
+
+	// Whole blocks only, so the loop wraps on a block boundary
+	numSamples = (int) (numValues / numChannels / settings.blockSize) * settings.blockSize;
+
+	if (numSamples == 0)
+		return false;
+
+	std::vector<float> interleaved((size_t) numSamples * numChannels);
+	file.seekg(0);
+	file.read((char*) interleaved.data(), sizeof(float) * interleaved.size());
+
+	source.resize(interleaved.size());
+
+	for (int t = 0; t < numSamples; ++t)
+		for (int c = 0; c < numChannels; ++c)
+			source[(size_t) c * numSamples + t] = interleaved[(size_t) t * numChannels + c];
+
+	return true;
+}
+
+/** Peak resident memory of the process, in MB */
+static double getPeakMemoryMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / 1048576.0;
+
+	return 0.0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1048576.0;
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static void printLatency(const char* name, const LatencyHistogram& histogram)
+{
+	if (histogram.getCount() == 0)
+		return;
+
+	std::printf("%-20s %10llu %10.1f %10.1f %10.1f %10.1f\n", name,
+				(unsigned long long) histogram.getCount(),
+				histogram.getPercentile(50) / 1000.0,
+				histogram.getPercentile(99) / 1000.0,
+				histogram.getPercentile(99.9) / 1000.0,
+				histogram.getMax() / 1000.0);
+}
+
+static int runBenchmark(const BenchmarkSettings& settings)
+{
+	std::vector<float> source;
+	int sourceSamples;
+
+	if (!loadSource(settings, source, sourceSamples))
+	{
+		std::fprintf(stderr, "Unable to read %s\n", settings.replayPath.c_str());
+		return 1;
+	}
+
+	const int numChannels = settings.numChannels;
+	const int blockSize = settings.blockSize;
+
+	std::filesystem::path path(settings.scriptPath);
+	const std::string moduleName = path.stem().string();
+
+	py::module_ sys = py::module_::import("sys");
+	sys.attr("path").attr("append")(std::filesystem::absolute(path).parent_path().string());
+
+	py::module_ module = py::module_::import(moduleName.c_str());
+
+	BenchmarkHost host;
+	py::object instance = module.attr("PyProcessor")(py::cast(&host, py::return_value_policy::reference),
+													 numChannels, settings.sampleRate);
+
+	PyCallbacks callbacks;
+	callbacks.resolve(instance);
+
+	const bool readOnly = settings.readOnly || py::getattr(module.attr("PyProcessor"), "read_only", py::bool_(false)).cast<bool>();
+
+	SampleConverter converter;
+	converter.setFormat(settings.format, settings.int16Scale);
+
+	ArrayPool blockArrays;
+	blockArrays.reset(converter.getDtypeName());
+	blockArrays.prepare(0, numChannels, blockSize);
+
+	ArrayPool spikeArrays;
+	spikeArrays.reset("float32");
+	spikeArrays.prepare(0, settings.spikeChannels, settings.spikeSamples);
+
+	SpikeBatch spikeBatch;
+	TTLBatch ttlBatch;
+
+	py::tuple electrodes = py::make_tuple(py::make_tuple(0, "Benchmark electrode", settings.spikeChannels, settings.spikeSamples));
+	py::tuple ttlChannels = py::make_tuple(py::make_tuple(0, "Benchmark TTL"));
+
+	CallbackStats stats;
+	LatencyHistogram blockTimes;
+
+	// The same event flushing, conversion and kernel call as the plugin
+	BlockRunner runner(stats, converter, blockArrays);
+
+	std::vector<float> output((size_t) numChannels * blockSize);
+	std::vector<float> waveform((size_t) settings.spikeChannels * settings.spikeSamples);
+	std::vector<float*> kernelChannels(numChannels);
+
+	const int64_t budget = (int64_t) (1.0e9 * blockSize / settings.sampleRate);
+	const double spikesPerBlock = settings.spikeRate * blockSize / settings.sampleRate;
+	const double ttlsPerBlock = settings.ttlRate * blockSize / settings.sampleRate;
+
+	double spikeCredit = 0.0;
+	double ttlCredit = 0.0;
+	bool ttlState = false;
+	int64_t numOutputEvents = 0;
+
+	if (callbacks.startAcquisition)
+		PyCallbacks::call(callbacks.startAcquisition);
+
+	const double setupMemory = getPeakMemoryMB();
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int block = 0; block < settings.numBlocks; ++block)
+	{
+		ScopedCallbackTimer blockTimer(blockTimes);
+
+		const int64_t firstSample = (int64_t) block * blockSize;
+		const int offset = (int) (firstSample % sourceSamples);
+
+		// Events arrive before the block, as with checkForEvents()
+		ttlCredit += ttlsPerBlock;
+		const int numTTLs = (int) ttlCredit;
+		ttlCredit -= numTTLs;
+
+		for (int i = 0; i < numTTLs; ++i)
+		{
+			const int64_t sampleNumber = firstSample + (int64_t) i * blockSize / numTTLs;
+			ttlState = !ttlState;
+
+			if (callbacks.handleTTLEvents)
+			{
+				ttlBatch.add(0, 0, sampleNumber, 0, ttlState);
+			}
+			else if (callbacks.handleTTLEvent)
+			{
+				ScopedCallbackTimer timer(stats.handleTTLEvent);
+				PyCallbacks::call(callbacks.handleTTLEvent, 0, "Benchmark TTL", sampleNumber, 0, ttlState);
+			}
+		}
+
+		spikeCredit += spikesPerBlock;
+		const int numSpikes = (int) spikeCredit;
+		spikeCredit -= numSpikes;
+
+		for (int i = 0; i < numSpikes; ++i)
+		{
+			const int64_t sampleNumber = firstSample + (int64_t) i * blockSize / numSpikes;
+			const float* spikeSource = source.data() + offset;
+
+			if (callbacks.handleSpikes)
+			{
+				float* row = spikeBatch.add(0, sampleNumber, 0, settings.spikeChannels, settings.spikeSamples);
+
+				for (int c = 0; c < settings.spikeChannels; ++c)
+					std::memcpy(row + (size_t) c * spikeBatch.getRowStride(), spikeSource + (size_t) (c % numChannels) * sourceSamples,
+								sizeof(float) * std::min(settings.spikeSamples, sourceSamples - offset));
+			}
+			else if (callbacks.handleSpike)
+			{
+				py::array spikeData = spikeArrays.acquire(0, settings.spikeChannels, settings.spikeSamples);
+
+				for (int c = 0; c < settings.spikeChannels; ++c)
+					std::memcpy(spikeData.mutable_data(c, 0), spikeSource + (size_t) (c % numChannels) * sourceSamples,
+								sizeof(float) * std::min(settings.spikeSamples, sourceSamples - offset));
+
+				ScopedCallbackTimer timer(stats.handleSpike);
+				PyCallbacks::call(callbacks.handleSpike, 0, "Benchmark electrode", settings.spikeChannels,
+								  settings.spikeSamples, sampleNumber, 0, spikeData);
+			}
+		}
+
+		runner.flushEvents(callbacks, ttlBatch, spikeBatch, ttlChannels, electrodes);
+
+		if (host.nativeKernel.isSet())
+		{
+			// The kernel works in place on float32 channels, as on the plugin's AudioBuffer
+			for (int c = 0; c < numChannels; ++c)
+			{
+				kernelChannels[c] = output.data() + (size_t) c * blockSize;
+				std::memcpy(kernelChannels[c], source.data() + (size_t) c * sourceSamples + offset, sizeof(float) * blockSize);
+			}
+
+			bool succeeded;
+
+			{
+				py::gil_scoped_release release;
+				succeeded = runner.callKernel(host.nativeKernel, kernelChannels.data(), numChannels, blockSize, firstSample, budget);
+			}
+
+			if (!succeeded)
+			{
+				std::fprintf(stderr, "The native process kernel returned an error at block %d\n", block);
+				return 1;
+			}
+		}
+		else
+		{
+			py::array data = runner.readBlock(0, numChannels, blockSize, readOnly,
+											  [&] (int c) { return source.data() + (size_t) c * sourceSamples + offset; });
+
+			{
+				ScopedCallbackTimer timer(stats.process, &stats.numOverruns, budget);
+				PyCallbacks::call(callbacks.process, data);
+			}
+
+			if (!readOnly)
+				runner.writeBlock(data, numChannels, blockSize, [&] (int c) { return output.data() + (size_t) c * blockSize; });
+		}
+
+		OutputEvent event;
+
+		while (host.outputEvents.pop(event))
+			++numOutputEvents;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (callbacks.stopAcquisition)
+		PyCallbacks::call(callbacks.stopAcquisition);
+
+	const double dataSeconds = (double) settings.numBlocks * blockSize / settings.sampleRate;
+
+	std::printf("Module:            %s\n", moduleName.c_str());
+	std::printf("Data:              %d channels x %d samples at %.0f Hz, %s%s\n", numChannels, blockSize,
+				settings.sampleRate, host.nativeKernel.isSet() ? "float32 to a native kernel" : converter.getDtypeName(),
+				readOnly ? ", read-only" : "");
+	std::printf("Blocks:            %d in %.3f s (%.1f blocks/s, %.1fx real time)\n",
+				settings.numBlocks, seconds, settings.numBlocks / seconds, dataSeconds / seconds);
+	std::printf("Overruns:          %llu\n", (unsigned long long) stats.numOverruns.load());
+	std::printf("Output events:     %lld\n", (long long) numOutputEvents);
+	std::printf("Peak memory:       %.1f MB (%.1f MB after setup)\n\n", getPeakMemoryMB(), setupMemory);
+
+	std::printf("%-20s %10s %10s %10s %10s %10s\n", "latency (us)", "calls", "p50", "p99", "p99.9", "max");
+	printLatency("block", blockTimes);
+	printLatency("process", stats.process);
+	printLatency("handle_spike(s)", stats.handleSpike);
+	printLatency("handle_ttl_event(s)", stats.handleTTLEvent);
+
+	if (!settings.csvPath.empty() && !stats.writeCsv(settings.csvPath))
+	{
+		std::fprintf(stderr, "Unable to write %s\n", settings.csvPath.c_str());
+		return 1;
+	}
+
+	spikeBatch.clear();
+	ttlBatch.clear();
+	blockArrays.clear();
+	spikeArrays.clear();
+	callbacks.clear();
+
+	if (settings.maxP99 > 0 && stats.process.getPercentile(99) / 1000.0 > settings.maxP99)
+	{
+		std::fprintf(stderr, "p99 process() latency exceeds %.1f us\n", settings.maxP99);
+		return 3;
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+
+	if (!parseArguments(argc, argv, settings))
+	{
+		printUsage();
+		return 2;
+	}
+
+	py::scoped_interpreter interpreter;
+
+	try
+	{
+		return runBenchmark(settings);
+	}
+	catch (py::error_already_set& e)
+	{
+		std::fprintf(stderr, "Python exception:\n%s\n", e.what());
+		return 1;
+	}
+}
@@ -18,20 +18,6 @@ def butter_bandpass(lowcut, highcut, sample_rate, order=2):
     sos = signal.butter(order, [lowcut, highcut], analog=False, btype='bandpass', output='sos', fs=sample_rate)
     return sos
 
-def butter_bandpass_filter(sos, data):
-    """
-    Filter data using the bandpass filter 
-
-    Parameters:
-    sos = Array of second-order filter coefficients
-    data = data to filter
-
-    Returns:
-    Second-order sections representation of the bandpass filter
-    """
-    y = signal.sosfilt(sos, data)
-    return y
-
 class PyProcessor:
     
     def __init__(self, processor, num_channels, sample_rate):
@@ -40,13 +26,11 @@ class PyProcessor:
         self.num_chans = num_channels
         self.sample_rate = sample_rate
         self.processor = processor
+        self.reported_error = False
         
-        self.sos = []
-        sos_t = butter_bandpass(500, 2000, sample_rate)
-        for i in range(self.num_chans):
-            self.sos.append(sos_t)
-        
-        self.sos = np.asarray(self.sos)
+        # One filter state per channel, carried across blocks
+        self.sos = butter_bandpass(500, 2000, sample_rate)
+        self.filter_bank = oe_pyprocessor.SosFilterBank(self.sos, self.num_chans)
     
     def process(self, data):
         """
@@ -55,15 +39,37 @@ class PyProcessor:
         Parameters:
         data - numpy array.
         """
+        # With selected_channels set, data has only the selected rows
+        if self.filter_bank.num_channels != data.shape[0]:
+            self.filter_bank = oe_pyprocessor.SosFilterBank(self.sos, data.shape[0])
+
         try:
-            for i in range(self.num_chans):
-                data[i] = butter_bandpass_filter(self.sos[i], data[i])
-        except:
-            pass
+            # Filters every channel in place, without holding the GIL
+            self.filter_bank.filter(data)
+        except (TypeError, ValueError) as e:
+            # Read-only or non-float32 data cannot be filtered in place
+            if not self.reported_error:
+                print("bandpass_filter: data passes through unfiltered:", e)
+                self.reported_error = True
         
     def start_acquisition(self):
         """ Called at start of acquisition """
-        pass
+        self.filter_bank.reset()
+
+    def transfer_state(self, old):
+        """ Keeps the running filter state when the script is reloaded during acquisition.
+        The new coefficients are kept, so an edited band takes effect at once """
+        old_bank = getattr(old, "filter_bank", None)
+
+        if old_bank is None:
+            return
+
+        if self.filter_bank.num_channels != old_bank.num_channels:
+            self.filter_bank = oe_pyprocessor.SosFilterBank(self.sos, old_bank.num_channels)
+
+        # A different filter order has a different state shape, so it starts from zero
+        if self.filter_bank.num_sections == old_bank.num_sections:
+            self.filter_bank.state = old_bank.state
     
     def stop_acquisition(self):
         """ Called when acquisition is stopped """
@@ -0,0 +1,134 @@
+"""
+Reads the stream published by the Python Processor's shared memory export.
+
+This is not a plugin script: run it in a separate Python process while the GUI
+is running, with "Export stream" enabled in the editor:
+
+    python shared_stream_reader.py oe_python_stream
+
+The segment layout is documented in Source/StreamExporter.h. Readers never slow
+down the plugin; a reader that falls more than a ring length behind skips ahead.
+"""
+
+import struct
+import sys
+import time
+from multiprocessing import shared_memory
+
+import numpy as np
+
+MAGIC = 0x4F455354
+VERSION = 1
+STOPPED, ACQUIRING, CLOSED = 0, 1, 2
+TTL_EVENT, SPIKE_EVENT = 1, 2
+
+EVENT_DTYPE = np.dtype([
+    ("sequence", "<u8"),
+    ("type", "<u4"),
+    ("source_node", "<i4"),
+    ("sample_number", "<i8"),
+    ("value", "<u4"),
+    ("state", "<u4"),
+    ("name", "S32"),
+])
+
+
+class StreamReader:
+
+    def __init__(self, name):
+        self.shm = shared_memory.SharedMemory(name=name)
+        try:
+            # The plugin owns the segment, so it must outlive this process
+            from multiprocessing import resource_tracker
+            resource_tracker.unregister(self.shm._name, "shared_memory")
+        except Exception:
+            pass
+
+        buf = self.shm.buf
+        magic, version = struct.unpack_from("<II", buf, 0)
+        if magic != MAGIC or version != VERSION:
+            raise RuntimeError("%s is not a Python Processor stream export" % name)
+
+        (self.stream_id, self.num_channels, self.ring_samples, self.sample_rate,
+         names_offset, samples_offset, numbers_offset, events_offset,
+         self.num_events) = struct.unpack_from("<IiidQQQQi", buf, 12)
+
+        self.channel_names = [
+            bytes(buf[names_offset + 64 * i:names_offset + 64 * (i + 1)]).split(b"\0")[0].decode()
+            for i in range(self.num_channels)
+        ]
+
+        # Zero-copy views of the segment
+        self.samples = np.ndarray((self.num_channels, self.ring_samples), np.float32, buf, samples_offset)
+        self.sample_numbers = np.ndarray((self.ring_samples,), np.int64, buf, numbers_offset)
+        self.events = np.ndarray((self.num_events,), EVENT_DTYPE, buf, events_offset)
+
+        # blocks written, samples written, samples being written, events written
+        self.counters = np.ndarray((4,), np.uint64, buf, 72)
+
+        # Only data published from now on
+        self.next_sample = int(self.counters[1])
+        self.next_event = int(self.counters[3])
+
+    @property
+    def state(self):
+        return struct.unpack_from("<I", self.shm.buf, 8)[0]
+
+    def read(self):
+        """
+        Returns (data, sample_numbers) for the samples published since the last call:
+        a channels x samples float32 copy, and the sample number of each column.
+        """
+        written = int(self.counters[1])
+        start = max(self.next_sample, written - self.ring_samples)
+        self.next_sample = written
+
+        indices = np.arange(start, written, dtype=np.uint64)
+        columns = indices % self.ring_samples
+        data = self.samples[:, columns]
+        sample_numbers = self.sample_numbers[columns]
+
+        # Drop the columns the writer has started overwriting during the copy
+        valid = indices >= int(self.counters[2]) - self.ring_samples
+        return data[:, valid], sample_numbers[valid]
+
+    def read_events(self):
+        """Returns the event records published since the last call, as a numpy record array"""
+        written = int(self.counters[3])
+        start = max(self.next_event, written - self.num_events)
+        self.next_event = written
+
+        slots = np.arange(start, written, dtype=np.uint64) % self.num_events
+        records = self.events[slots]
+
+        # A record is intact if its sequence matches before and after the copy
+        expected = np.arange(start, written, dtype=np.uint64) + 1
+        intact = (records["sequence"] == expected) & (self.events["sequence"][slots] == expected)
+        return records[intact]
+
+
+def main():
+    reader = StreamReader(sys.argv[1] if len(sys.argv) > 1 else "oe_python_stream")
+
+    print("Stream %d: %d channels at %.1f Hz" % (reader.stream_id, reader.num_channels, reader.sample_rate))
+
+    while reader.state != CLOSED:
+        time.sleep(1.0)
+
+        data, sample_numbers = reader.read()
+        events = reader.read_events()
+
+        if sample_numbers.size == 0:
+            continue
+
+        rms = np.sqrt(np.mean(np.square(data, dtype=np.float64), axis=1))
+        print("samples %d-%d  mean RMS %.2f  TTL events %d  spikes %d" % (
+            sample_numbers[0], sample_numbers[-1], rms.mean(),
+            np.count_nonzero(events["type"] == TTL_EVENT),
+            np.count_nonzero(events["type"] == SPIKE_EVENT)))
+
+    print("The export was closed")
+
+
+if __name__ == "__main__":
+    main()
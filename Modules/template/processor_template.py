@@ -3,15 +3,48 @@ import oe_pyprocessor
 # Add additional imports here
 
 class PyProcessor:
+
+    # Set to True if process() never modifies data. The data is then passed read-only
+    # and not copied back into the signal chain.
+    read_only = False
+
+    # Number of output channels, or a list of their names, appended to the selected stream
+    # for values computed by the script (band power, decoder outputs...). process() is then
+    # called as process(data, outputs). Only available for whole blocks of a single stream
+    # at full rate, without async mode.
+    output_channels = 0
     
     def __init__(self, processor, num_channels, sample_rate):
         """ 
         A new processor is initialized whenever the plugin settings are updated
         
         Parameters:
-        processor (object): Python Processor class object used for adding events from python.
+        processor (object): Python Processor class object used for adding events from python:
+                            processor.add_python_event(line, state, sample_offset=0) or
+                            processor.add_python_events(lines, states, sample_offsets=None) with numpy arrays.
+                            sample_offset is the sample within the data passed to the current call
+                            (the block or window, at the decimated rate if decimation is on; the selected
+                            stream's block for the event hooks). Decimated data lags the signal by the
+                            anti-alias filter's delay of 8 decimated samples, which the plugin subtracts
+                            when it places these events. Events whose sample has already left the
+                            plugin (async mode, late blocks) are added at the start of the next block,
+                            with their own sample number.
         num_channels (int): number of input channels in the selected stream.
-        sample_rate (float): sample rate of the selected stream
+        sample_rate (float): sample rate of the selected stream (after decimation, if set in the editor)
+
+        In multi-stream mode, num_channels and sample_rate are dicts keyed by stream ID.
+
+        To receive only some channels, set self.selected_channels to a list of channel
+        indices (counting from 0). process() then gets only those rows, and the other
+        channels pass through untouched. A selection entered in the editor takes precedence.
+
+        For the lowest latency, register a compiled function (e.g. a numba @cfunc) with
+        processor.register_native_process(func, signature="void(float**, int32, int32)").
+        It is called as func(channels, num_channels, num_samples) instead of process(), without
+        the GIL, with float32 pointers to the selected channels followed by the output channels.
+        "int32(...)" kernels stop the script by returning non-zero, and an int64 fourth argument
+        receives the first sample number of the block. Whole blocks of a single stream only,
+        in sync mode without a deadline; process() is used otherwise, so keep it defined.
         """
         print("Num Channels: ", num_channels, " | Sample Rate: ", sample_rate)
         # pass
@@ -22,6 +55,26 @@ class PyProcessor:
         
         Parameters:
         data - N x M numpy array, where N = num_channles, M = num of samples in the buffer.
+               In multi-stream mode, a dict of such arrays keyed by stream ID.
+
+        When a window size is set in the editor, process is called as process(data, sample_number)
+        with exactly window-size samples per channel, every hop samples. sample_number is the
+        first sample of the window. Windows are read-only and are not written back.
+
+        When output_channels is set, process is called as process(data, outputs). outputs is
+        a K x M float32 array for the K output channels, zeroed before each call. Values written
+        to it travel downstream with the stream; it usually maps onto the output channels directly.
+
+        In async mode, process runs on a worker thread after the block has left the plugin, so
+        data is read-only. In multi-stream async mode it still gets every stream of a block in one dict.
+
+        With zero_copy, data (and outputs) view the signal chain's buffer and are only valid
+        during this call: never keep them (self.last = data) without .copy(). A kept view is
+        detected, and later blocks are then passed as copies.
+
+        data is float32 unless a dtype is selected in the editor. float16 halves the bytes
+        handed to Python; int16 holds round(sample / int16_scale). Changes made to either
+        are converted back to float32 when the data is written back.
         """
         try:
             pass
@@ -31,6 +84,16 @@ class PyProcessor:
     def start_acquisition(self):
         """ Called at start of acquisition """
         pass
+
+    def transfer_state(self, old):
+        """
+        Called when the script is reloaded during acquisition, after start_acquisition()
+        and before this instance replaces old, the instance built from the previous version.
+        Copy across any state that should survive the reload, such as filter state.
+        Both run on a background thread while old keeps processing until the swap, so the
+        state copied may be a few blocks behind. old.stop_acquisition() follows the swap.
+        """
+        pass
     
     def stop_acquisition(self):
         """ Called when acquisition is stopped """
@@ -49,6 +112,23 @@ class PyProcessor:
         """
         pass
 
+    # Define handle_ttl_events instead of handle_ttl_event to receive all events of a block in one call
+    # def handle_ttl_events(self, source_nodes, channel_indices, sample_numbers, lines, states, channels):
+    #     """
+    #     Handle all ttl events that arrived with the current data buffer.
+    #
+    #     Parameters:
+    #     source_nodes (numpy array): E int32 processor ids, where E = number of events
+    #     channel_indices (numpy array): E int32 indices into channels
+    #     sample_numbers (numpy array): E int64 sample numbers
+    #     lines (numpy array): E uint8 lines (0-255)
+    #     states (numpy array): E bool states
+    #     channels (tuple): (source_node, channel_name) of each event channel, the same object on every call
+    #
+    #     The arrays are read-only and reused for the next buffer, so copy anything you keep.
+    #     """
+    #     pass
+
     def handle_spike(self, source_node, electrode_name, num_channels, num_samples, sample_number, sorted_id, spike_data):
         """
         Handle each incoming spike.
@@ -63,6 +143,23 @@ class PyProcessor:
         spike_data (numpy array): N x M numpy array, where N = num_channels & M = num_samples (read-only).
         """
         pass
+
+    # Define handle_spikes instead of handle_spike to receive all spikes of a block in one call
+    # def handle_spikes(self, waveforms, sample_numbers, sorted_ids, electrode_indices, electrodes):
+    #     """
+    #     Handle all spikes that arrived with the current data buffer.
+    #
+    #     Parameters:
+    #     waveforms (numpy array): S x N x M float32 array, where S = number of spikes. N and M are
+    #                              the largest electrode's channels and samples; smaller electrodes are zero padded.
+    #     sample_numbers (numpy array): S int64 sample numbers
+    #     sorted_ids (numpy array): S uint16 sorted IDs
+    #     electrode_indices (numpy array): S int32 indices into electrodes
+    #     electrodes (tuple): (source_node, electrode_name, num_channels, num_samples) of each electrode
+    #
+    #     The arrays are read-only and reused for the next buffer, so copy anything you keep.
+    #     """
+    #     pass
     
     def start_recording(self, recording_dir):
         """ 
@@ -70,9 +167,20 @@ class PyProcessor:
 
         Parameters:
         recording_dir (str): recording directory to be used by future record nodes.
+
+        To save derived data without blocking process() on disk I/O, open a writer here:
+            self.writer = oe_pyprocessor.NpyWriter(recording_dir, "features.npy")
+        self.writer.write(rows) copies the rows (appended along the first axis) into a buffer
+        that a background thread appends to the .npy file. bytes_written, rows_written,
+        pending_bytes, flush_count, last_flush_ms and max_flush_ms report its progress.
+        write() never waits or allocates: rows that do not fit while the previous buffer
+        is still being written are dropped and counted in rows_dropped (raise buffer_size).
         """
         pass
     
     def stop_recording(self):
-        """ Called when recording stops """
+        """ 
+        Called when recording stops. Close any NpyWriter here (self.writer.close()).
+        Closing waits for the file to be written, so never close or drop a writer in process().
+        """
         pass
\ No newline at end of file
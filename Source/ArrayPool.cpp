@@ -0,0 +1,116 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "ArrayPool.h"
+
+ArrayPool::ArrayPool()
+	: dtypeName("float32")
+{
+}
+
+void ArrayPool::reset(const char* dtypeName_)
+{
+	entries.clear();
+	dtypeName = dtypeName_;
+}
+
+void ArrayPool::prepare(int key, int numRows, int numSamples)
+{
+	allocate(entries[key], numRows, numSamples);
+}
+
+py::array ArrayPool::acquire(int key, int numRows, int numSamples)
+{
+	auto entry = entries.find(key);
+
+	if (entry == entries.end())
+		return py::array(py::dtype(dtypeName), std::vector<py::ssize_t> { numRows, numSamples });
+
+	Entry& e = entry->second;
+
+	// The pool holds one reference to buffer, plus one per view (its base). Any more, or more
+	// than one to a view, means the script kept an array, or an array derived from one
+	bool isKept = e.buffer.ref_count() > 1 + (py::ssize_t) e.views.size();
+
+	for (auto& view : e.views)
+		isKept = isKept || view.second.ref_count() > 1;
+
+	if (isKept || numRows != e.numRows || numSamples > e.capacity)
+	{
+		int capacity = e.capacity;
+
+		while (capacity < numSamples)
+			capacity *= 2;
+
+		allocate(e, numRows, capacity);
+	}
+
+	py::array* view = &e.buffer;
+
+	if (numSamples != e.capacity)
+	{
+		auto cached = e.views.find(numSamples);
+
+		if (cached == e.views.end())
+		{
+			if ((int) e.views.size() >= maxViews)
+				e.views.clear();
+
+			cached = e.views.emplace(numSamples,
+									 py::array(e.buffer.dtype(), std::vector<py::ssize_t> { numRows, numSamples },
+											   std::vector<py::ssize_t> { e.buffer.strides(0), e.buffer.strides(1) },
+											   e.buffer.data(), e.buffer)).first;
+		}
+
+		view = &cached->second;
+	}
+
+	// Blocks may have been handed out read-only. A view can only be made writeable if its base is
+	if (!view->writeable())
+	{
+		if (!e.buffer.writeable())
+			e.buffer.attr("flags").attr("writeable") = true;
+
+		view->attr("flags").attr("writeable") = true;
+	}
+
+	return *view;
+}
+
+void ArrayPool::clear()
+{
+	entries.clear();
+}
+
+void ArrayPool::allocate(Entry& entry, int numRows, int capacity)
+{
+	capacity = capacity > 0 ? capacity : 1;
+
+	// Views of the old buffer are released first, or they would keep it alive
+	entry.views.clear();
+	entry.buffer = py::array(py::dtype(dtypeName), std::vector<py::ssize_t> { numRows, capacity });
+	entry.numRows = numRows;
+	entry.capacity = capacity;
+}
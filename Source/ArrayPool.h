@@ -0,0 +1,94 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ARRAYPOOL_H_DEFINED
+#define ARRAYPOOL_H_DEFINED
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <map>
+#include <string>
+
+namespace py = pybind11;
+
+/**
+	Preallocated (rows x samples) numpy arrays, reused for every block or
+	spike passed to Python instead of allocating a new array each time.
+
+	Each key (a stream or an electrode) owns one array sized for the
+	largest block seen so far. Shorter blocks get a view of its first
+	samples, cached per length, so block sizes that alternate (e.g. after
+	decimation) still allocate nothing in the steady state. If the script
+	kept an array it was given, the key gets a new array rather than
+	overwriting it.
+
+	prepare() and clear() change the set of keys and must not run while
+	other threads call acquire(). All methods must be called with the GIL held.
+*/
+class ArrayPool
+{
+public:
+
+	/** Constructor */
+	ArrayPool();
+
+	/** Releases every array and sets the dtype of the arrays allocated from now on */
+	void reset(const char* dtypeName);
+
+	/** Allocates the array of a key */
+	void prepare(int key, int numRows, int numSamples);
+
+	/** Returns a writeable (numRows x numSamples) array, reusing the key's array where possible.
+		Keys that were not prepared get a new array every time */
+	py::array acquire(int key, int numRows, int numSamples);
+
+	/** Releases every array */
+	void clear();
+
+private:
+
+	struct Entry
+	{
+		/** The allocated array */
+		py::array buffer;
+
+		/** Views of the first samples of buffer, by number of samples */
+		std::map<int, py::array> views;
+
+		int numRows;
+		int capacity;
+	};
+
+	/** Lengths cached per key. Past this the cache starts over, as block sizes are not settling */
+	static const int maxViews = 4;
+
+	/** Allocates a new array for an entry */
+	void allocate(Entry& entry, int numRows, int capacity);
+
+	std::string dtypeName;
+
+	std::map<int, Entry> entries;
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "AsyncWorker.h"
+#include "PythonProcessor.h"
+
+AsyncWorker::AsyncWorker(PythonProcessor* processor_, BlockQueue* queue_)
+	: Thread("Python Worker"),
+	  processor(processor_),
+	  queue(queue_)
+{
+}
+
+void AsyncWorker::run()
+{
+	while (!threadShouldExit())
+	{
+		if (queue->getNumQueued() == 0)
+		{
+			// Woken by notify() from the audio thread
+			wait(10);
+			continue;
+		}
+
+		// Hold the GIL for the whole batch, releasing it between batches
+		// so the message thread can reach the interpreter
+		py::gil_scoped_acquire acquire;
+
+		while (QueuedItem* item = queue->beginRead())
+		{
+			processor->handleQueuedItem(*item);
+			queue->finishRead();
+
+			if (threadShouldExit())
+				break;
+		}
+	}
+}
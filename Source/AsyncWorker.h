@@ -0,0 +1,56 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ASYNCWORKER_H_DEFINED
+#define ASYNCWORKER_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+#include "BlockQueue.h"
+
+class PythonProcessor;
+
+/** 
+	Drains the BlockQueue on its own thread, holding the GIL while
+	queued items are handed to the Python module.
+*/
+class AsyncWorker : public Thread
+{
+public:
+
+	/** Constructor */
+	AsyncWorker(PythonProcessor* processor, BlockQueue* queue);
+
+	/** Destructor */
+	~AsyncWorker() { }
+
+	/** Waits for queued items and passes them to the processor */
+	void run() override;
+
+private:
+
+	PythonProcessor* processor;
+	BlockQueue* queue;
+};
+
+#endif
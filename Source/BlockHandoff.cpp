@@ -0,0 +1,92 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "BlockHandoff.h"
+
+BlockHandoff::BlockHandoff()
+	: buffer(nullptr),
+	  state(IDLE)
+{
+}
+
+bool BlockHandoff::start(AudioBuffer<float>& buffer_)
+{
+	if (state.load() != IDLE)
+		return false;
+
+	buffer = &buffer_;
+	state = WAITING;
+	blockReady.signal();
+
+	return true;
+}
+
+bool BlockHandoff::wait(int timeoutMs)
+{
+	const uint32 endTime = Time::getMillisecondCounter() + (uint32) timeoutMs;
+
+	// blockDone may also have been signalled by an earlier, abandoned block
+	while (state.load() != IDLE)
+	{
+		const int remainingMs = (int) (endTime - Time::getMillisecondCounter());
+
+		if (remainingMs > 0)
+		{
+			blockDone.wait(remainingMs);
+			continue;
+		}
+
+		int current = state.load();
+
+		if ((current == WAITING || current == RUNNING) && state.compare_exchange_strong(current, ABANDONED))
+			return false;
+
+		// Only a copy to or from the buffer is left to wait for
+		Thread::yield();
+	}
+
+	return true;
+}
+
+bool BlockHandoff::beginBufferAccess()
+{
+	int current = state.load();
+
+	while ((current == WAITING || current == RUNNING) && !state.compare_exchange_weak(current, ACCESSING))
+	{
+	}
+
+	return current == WAITING || current == RUNNING;
+}
+
+void BlockHandoff::endBufferAccess()
+{
+	state = RUNNING;
+}
+
+void BlockHandoff::finish()
+{
+	// Idle before the signal, as wait() only trusts the state
+	state = IDLE;
+	blockDone.signal();
+}
@@ -0,0 +1,91 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BLOCKHANDOFF_H_DEFINED
+#define BLOCKHANDOFF_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+#include <atomic>
+
+/**
+	Hands the processing thread's block to a Python thread and waits a
+	limited time for it. A block that misses its deadline is abandoned: the
+	Python thread finishes its call, but no longer touches the AudioBuffer,
+	and gets no new blocks until it is idle again.
+
+	Used by StreamShard and DeadlineWorker. The processing thread calls
+	start() and wait(); the Python thread calls waitForStart(), brackets its
+	reads and writes of the buffer with beginBufferAccess() / endBufferAccess(),
+	and calls finish() once Python has returned.
+*/
+class BlockHandoff
+{
+public:
+
+	/** Constructor */
+	BlockHandoff();
+
+	/** Hands a block over. Returns false if the Python thread is still busy with an abandoned block */
+	bool start(AudioBuffer<float>& buffer);
+
+	/** Waits until the block is finished. After timeoutMs the block is abandoned and false
+		is returned, unless the Python thread is copying to or from the buffer */
+	bool wait(int timeoutMs);
+
+	/** True from start() until finish() */
+	bool isBusy() const { return state.load() != IDLE; }
+
+	/** Waits up to timeoutMs for start(). Returns false if no block was handed over */
+	bool waitForStart(int timeoutMs) { return blockReady.wait(timeoutMs); }
+
+	/** The buffer passed to start(), only valid between begin and endBufferAccess() */
+	AudioBuffer<float>& getBuffer() const { return *buffer; }
+
+	/** Returns false if the block was abandoned, in which case the buffer must not be touched */
+	bool beginBufferAccess();
+	void endBufferAccess();
+
+	/** Marks the block as done, abandoned or not */
+	void finish();
+
+private:
+
+	AudioBuffer<float>* buffer;
+
+	WaitableEvent blockReady;
+	WaitableEvent blockDone;
+
+	enum State
+	{
+		IDLE = 0,
+		WAITING,
+		ACCESSING,
+		RUNNING,
+		ABANDONED
+	};
+
+	std::atomic<int> state;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "BlockQueue.h"
+
+#include <chrono>
+#include <thread>
+
+BlockQueue::BlockQueue()
+	: capacity(0),
+	  overflowPolicy(DROP_OLDEST),
+	  slotSamples(0),
+	  head(0),
+	  tail(0),
+	  reading(-1),
+	  numDropped(0),
+	  isOpen(false)
+{
+}
+
+void BlockQueue::prepare(int depth, OverflowPolicy policy, size_t maxItemSamples)
+{
+	capacity = depth > 0 ? depth : 1;
+	overflowPolicy = policy;
+	slotSamples = maxItemSamples;
+
+	// One extra slot keeps the item being read out of the producer's way
+	slots.resize(capacity + 1);
+
+	// The producer never allocates, so every slot holds the largest item up front
+	for (auto& slot : slots)
+		slot.data.resize(slotSamples);
+
+	head = 0;
+	tail = 0;
+	reading = -1;
+	numDropped = 0;
+	isOpen = true;
+}
+
+void BlockQueue::close()
+{
+	isOpen = false;
+}
+
+QueuedItem* BlockQueue::beginWrite(size_t numSamples)
+{
+	if (!isOpen)
+		return nullptr;
+
+	if (numSamples > slotSamples)
+	{
+		numDropped++;
+		return nullptr;
+	}
+
+	const int64_t h = head.load();
+	const int64_t numSlots = (int64_t) slots.size();
+
+	std::chrono::steady_clock::time_point waitEnd;
+	bool isWaiting = false;
+
+	while (h - tail.load() >= capacity)
+	{
+		if (overflowPolicy == DROP_OLDEST)
+		{
+			int64_t t = tail.load();
+
+			// If this fails the consumer took the item, which frees a slot as well
+			if (h - t >= capacity && tail.compare_exchange_strong(t, t + 1))
+				numDropped++;
+		}
+		else if (overflowPolicy == BLOCK && isOpen
+				 && (!isWaiting || std::chrono::steady_clock::now() < waitEnd))
+		{
+			if (!isWaiting)
+			{
+				waitEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxBlockingWaitMs);
+				isWaiting = true;
+			}
+
+			std::this_thread::yield();
+		}
+		else
+		{
+			numDropped++;
+			return nullptr;
+		}
+	}
+
+	// After dropping the oldest items, the producer may have caught up with
+	// a slot the consumer is still reading
+	const int64_t r = reading.load();
+
+	if (r >= 0 && r % numSlots == h % numSlots)
+	{
+		numDropped++;
+		return nullptr;
+	}
+
+	return &slots[h % numSlots];
+}
+
+void BlockQueue::finishWrite()
+{
+	head++;
+}
+
+QueuedItem* BlockQueue::beginRead()
+{
+	int64_t t = tail.load();
+
+	while (t < head.load())
+	{
+		reading = t;
+
+		if (tail.compare_exchange_strong(t, t + 1))
+			return &slots[t % (int64_t) slots.size()];
+	}
+
+	reading = -1;
+	return nullptr;
+}
+
+void BlockQueue::finishRead()
+{
+	reading = -1;
+}
+
+int BlockQueue::getNumQueued() const
+{
+	const int64_t numQueued = head.load() - tail.load();
+	return numQueued > 0 ? (int) numQueued : 0;
+}
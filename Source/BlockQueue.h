@@ -0,0 +1,139 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BLOCKQUEUE_H_DEFINED
+#define BLOCKQUEUE_H_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** A block, TTL event or spike waiting to be handed to Python */
+struct QueuedItem
+{
+	enum class Type { BLOCK, TTL, SPIKE };
+
+	Type type;
+
+	uint16_t streamId;
+	int64_t sampleNumber;
+
+	/** Full-rate first sample of the stream's block the event or spike arrived in */
+	int64_t blockSampleNumber;
+
+	/** Counts the processing thread's blocks, so the streams of one block can be passed together */
+	int64_t blockIndex;
+	bool lastInBlock;
+
+	/** Continuous block or spike waveform shape */
+	int numChannels;
+	int numSamples;
+
+	/** Event / spike source info. channelIndex is the TTL channel's or electrode's
+		position in the tables passed to Python, used by the deadline worker's batches
+		and the async worker's pooled spike arrays */
+	int sourceNodeId;
+	int channelIndex;
+	char channelName[128];
+	uint8_t line;
+	bool state;
+	uint16_t sortedId;
+
+	/** Sample data (channels x samples), allocated by BlockQueue::prepare() */
+	std::vector<float> data;
+};
+
+/** 
+	Preallocated single-producer / single-consumer ring of QueuedItems.
+
+	The producer (audio thread) fills a slot returned by beginWrite() and publishes it
+	with finishWrite(); the consumer (worker thread) does the same with beginRead()
+	and finishRead(). No locks are taken on either side.
+*/
+class BlockQueue
+{
+public:
+
+	/** What to do when the producer finds the ring full */
+	enum OverflowPolicy
+	{
+		DROP_OLDEST = 0,
+		DROP_NEWEST,
+		BLOCK
+	};
+
+	/** Constructor */
+	BlockQueue();
+
+	/** Allocates the ring for a given number of queued items of up to maxItemSamples
+		floats each. Not real-time safe. */
+	void prepare(int depth, OverflowPolicy policy, size_t maxItemSamples);
+
+	/** Releases a producer waiting under the BLOCK policy and rejects further writes */
+	void close();
+
+	/** Returns the next free slot for an item of numSamples floats, or nullptr if the item
+		must be dropped. Under the BLOCK policy, waits at most maxBlockingWaitMs for a slot */
+	QueuedItem* beginWrite(size_t numSamples);
+
+	/** Publishes the slot returned by beginWrite() */
+	void finishWrite();
+
+	/** Returns the oldest queued slot, or nullptr if the ring is empty */
+	QueuedItem* beginRead();
+
+	/** Releases the slot returned by beginRead() */
+	void finishRead();
+
+	/** Number of items waiting to be read */
+	int getNumQueued() const;
+
+	/** Maximum number of items that can be queued */
+	int getCapacity() const { return capacity; }
+
+	/** Number of items dropped since prepare() */
+	int64_t getNumDropped() const { return numDropped.load(); }
+
+	/** Longest time the BLOCK policy holds up the producer before dropping the newest item */
+	static const int maxBlockingWaitMs = 2;
+
+private:
+
+	std::vector<QueuedItem> slots;
+
+	int capacity;
+	OverflowPolicy overflowPolicy;
+	size_t slotSamples;
+
+	std::atomic<int64_t> head;
+	std::atomic<int64_t> tail;
+
+	/** Index of the slot the consumer is currently reading, or -1 */
+	std::atomic<int64_t> reading;
+
+	std::atomic<int64_t> numDropped;
+	std::atomic<bool> isOpen;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "BlockRunner.h"
+
+BlockRunner::BlockRunner(CallbackStats& stats_, const SampleConverter& converter_, ArrayPool& blockArrays_)
+	: stats(stats_),
+	  converter(converter_),
+	  blockArrays(blockArrays_)
+{
+}
+
+void BlockRunner::flushEvents(PyCallbacks& target, TTLBatch& ttls, SpikeBatch& spikes,
+							  const py::object& eventChannels, const py::object& electrodes)
+{
+	if (ttls.size() > 0)
+	{
+		ScopedCallbackTimer timer(stats.handleTTLEvent);
+
+		if (target.handleTTLEvents)
+			ttls.flush(target.handleTTLEvents, eventChannels);
+		else
+			ttls.flushEach(target.handleTTLEvent, eventChannels);
+	}
+
+	if (spikes.size() > 0)
+	{
+		ScopedCallbackTimer timer(stats.handleSpike);
+
+		if (target.handleSpikes)
+			spikes.flush(target.handleSpikes, electrodes);
+		else
+			spikes.flushEach(target.handleSpike, electrodes);
+	}
+}
+
+bool BlockRunner::callKernel(NativeKernel& kernel, float** channels, int numChannels, int numSamples,
+							 int64_t firstSample, int64_t budget)
+{
+	ScopedCallbackTimer timer(stats.process, &stats.numOverruns, budget);
+	return kernel.call(channels, numChannels, numSamples, firstSample);
+}
+
+void BlockRunner::setReadOnly(py::handle array)
+{
+	array.attr("flags").attr("writeable") = false;
+}
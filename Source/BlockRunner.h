@@ -0,0 +1,102 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BLOCKRUNNER_H_DEFINED
+#define BLOCKRUNNER_H_DEFINED
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <cstdint>
+
+#include "ArrayPool.h"
+#include "CallbackStats.h"
+#include "NativeKernel.h"
+#include "PyCallbacks.h"
+#include "SampleConverter.h"
+#include "SpikeBatch.h"
+#include "TTLBatch.h"
+
+namespace py = pybind11;
+
+/**
+	The steps of one block shared by the plugin and the headless benchmark,
+	kept free of JUCE so both time the same code.
+
+	A block runs as: the events read before it, handed to Python in batches
+	(flushEvents), then either the native kernel in place (callKernel) or
+	process() on a pooled array from readBlock(), written back with
+	writeBlock() unless the script is read-only.
+*/
+class BlockRunner
+{
+public:
+
+	/** Constructor. The converter and pool are those of the owner, and must outlive the runner */
+	BlockRunner(CallbackStats& stats, const SampleConverter& converter, ArrayPool& blockArrays);
+
+	/** Passes the batched TTL events and spikes to the batch hooks, or to the per-event hooks
+		one at a time. Each batch is timed as one call. GIL must be held */
+	void flushEvents(PyCallbacks& target, TTLBatch& ttls, SpikeBatch& spikes,
+					 const py::object& eventChannels, const py::object& electrodes);
+
+	/** Copies numChannels channels (channel(i) returns channel i) into a pooled array
+		in the script's dtype. GIL must be held */
+	template <typename ChannelReader>
+	py::array readBlock(uint16_t streamId, int numChannels, int numSamples, bool readOnly, ChannelReader channel)
+	{
+		py::array data = blockArrays.acquire(streamId, numChannels, numSamples);
+
+		for (int i = 0; i < numChannels; ++i)
+			converter.toPython(channel(i), data.mutable_data(i, 0), numSamples);
+
+		if (readOnly)
+			setReadOnly(data);
+
+		return data;
+	}
+
+	/** Copies a block the script may have changed back into channel(i) */
+	template <typename ChannelWriter>
+	void writeBlock(const py::array& data, int numChannels, int numSamples, ChannelWriter channel)
+	{
+		for (int i = 0; i < numChannels; ++i)
+			converter.fromPython(data.data(i, 0), channel(i), numSamples);
+	}
+
+	/** Runs the kernel in place, timed against budget (ns). Call without the GIL.
+		Returns false if the kernel reported an error */
+	bool callKernel(NativeKernel& kernel, float** channels, int numChannels, int numSamples,
+					int64_t firstSample, int64_t budget);
+
+	/** Clears an array's writeable flag, so Python raises instead of writing to it */
+	static void setReadOnly(py::handle array);
+
+private:
+
+	CallbackStats& stats;
+	const SampleConverter& converter;
+	ArrayPool& blockArrays;
+};
+
+#endif
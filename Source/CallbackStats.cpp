@@ -0,0 +1,156 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "CallbackStats.h"
+
+#include <fstream>
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+int LatencyHistogram::getBucketIndex(uint64_t value)
+{
+	if (value < (uint64_t) subBucketCount)
+		return (int) value;
+
+	int msb = 63;
+
+	while ((value >> msb) == 0)
+		msb--;
+
+	// Keep the top subBucketBits + 1 bits of the value
+	const int shift = msb - subBucketBits;
+	const int mantissa = (int) (value >> shift);
+
+	return (shift + 1) * subBucketCount + (mantissa - subBucketCount);
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int index)
+{
+	if (index < subBucketCount)
+		return (uint64_t) index;
+
+	const int shift = index / subBucketCount - 1;
+	const uint64_t mantissa = (uint64_t) (subBucketCount + index % subBucketCount);
+
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t nanoseconds)
+{
+	const uint64_t value = nanoseconds > 0 ? (uint64_t) nanoseconds : 0;
+
+	buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t previousMax = maximum.load(std::memory_order_relaxed);
+
+	while (value > previousMax
+		   && !maximum.compare_exchange_weak(previousMax, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+void LatencyHistogram::reset()
+{
+	for (auto& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+
+	count = 0;
+	sum = 0;
+	maximum = 0;
+}
+
+double LatencyHistogram::getMean() const
+{
+	const uint64_t n = getCount();
+	return n > 0 ? (double) sum.load(std::memory_order_relaxed) / (double) n : 0.0;
+}
+
+int64_t LatencyHistogram::getPercentile(double percentile) const
+{
+	const uint64_t n = getCount();
+
+	if (n == 0)
+		return 0;
+
+	const uint64_t target = (uint64_t) ((percentile / 100.0) * (double) n + 0.5);
+	uint64_t seen = 0;
+
+	for (int i = 0; i < numBuckets; ++i)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+
+		if (seen >= target && seen > 0)
+		{
+			// The bucket bound can exceed the largest value actually seen
+			const int64_t bound = (int64_t) getBucketUpperBound(i);
+			return bound < getMax() ? bound : getMax();
+		}
+	}
+
+	return getMax();
+}
+
+void CallbackStats::reset()
+{
+	process.reset();
+	handleSpike.reset();
+	handleTTLEvent.reset();
+	numOverruns = 0;
+	numMissedDeadlines = 0;
+	numSkippedBlocks = 0;
+	numLateEvents = 0;
+}
+
+bool CallbackStats::writeCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+
+	if (!file)
+		return false;
+
+	file << "callback,count,mean_us,p50_us,p90_us,p99_us,p99.9_us,max_us,overruns\n";
+
+	auto writeRow = [&file](const char* name, const LatencyHistogram& histogram, uint64_t overruns)
+	{
+		file << name << ","
+			 << histogram.getCount() << ","
+			 << histogram.getMean() / 1000.0 << ","
+			 << histogram.getPercentile(50.0) / 1000.0 << ","
+			 << histogram.getPercentile(90.0) / 1000.0 << ","
+			 << histogram.getPercentile(99.0) / 1000.0 << ","
+			 << histogram.getPercentile(99.9) / 1000.0 << ","
+			 << histogram.getMax() / 1000.0 << ","
+			 << overruns << "\n";
+	};
+
+	writeRow("process", process, numOverruns.load());
+	writeRow("handle_spike", handleSpike, 0);
+	writeRow("handle_ttl_event", handleTTLEvent, 0);
+
+	return (bool) file;
+}
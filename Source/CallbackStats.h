@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CALLBACKSTATS_H_DEFINED
+#define CALLBACKSTATS_H_DEFINED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+	Lock-free latency histogram with log-linear buckets (16 per power of two,
+	about 6% resolution), in the style of HdrHistogram. record() may be called
+	from any thread; readers see a consistent-enough snapshot for display.
+*/
+class LatencyHistogram
+{
+public:
+
+	/** Constructor */
+	LatencyHistogram();
+
+	/** Adds one measurement, in nanoseconds */
+	void record(int64_t nanoseconds);
+
+	/** Clears all measurements. Not safe to call while recording. */
+	void reset();
+
+	/** Number of measurements */
+	uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+
+	/** Mean, in nanoseconds */
+	double getMean() const;
+
+	/** Largest measurement, in nanoseconds */
+	int64_t getMax() const { return (int64_t) maximum.load(std::memory_order_relaxed); }
+
+	/** Upper bound of the bucket holding the given percentile (0-100), in nanoseconds */
+	int64_t getPercentile(double percentile) const;
+
+private:
+
+	static const int subBucketBits = 4;
+	static const int subBucketCount = 1 << subBucketBits;
+	static const int numBuckets = (64 - subBucketBits + 1) * subBucketCount;
+
+	static int getBucketIndex(uint64_t value);
+	static uint64_t getBucketUpperBound(int index);
+
+	std::array<std::atomic<uint64_t>, numBuckets> buckets;
+
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> maximum;
+};
+
+/** Timing of each Python callback, plus blocks that took longer than they last */
+struct CallbackStats
+{
+	LatencyHistogram process;
+	LatencyHistogram handleSpike;
+	LatencyHistogram handleTTLEvent;
+
+	/** process() calls that took longer than the real-time duration of their block */
+	std::atomic<uint64_t> numOverruns { 0 };
+
+	/** Blocks passed on without waiting for Python because they missed their deadline,
+		and blocks that skipped Python while it was still finishing a late block */
+	std::atomic<uint64_t> numMissedDeadlines { 0 };
+	std::atomic<uint64_t> numSkippedBlocks { 0 };
+
+	/** TTL events from Python whose sample had already left the plugin (async mode, late
+		deadline blocks, windows), added at the start of a later block with their own sample number */
+	std::atomic<uint64_t> numLateEvents { 0 };
+
+	/** Clears all histograms and counters */
+	void reset();
+
+	/** Writes a summary row per callback. Returns false if the file can't be written. */
+	bool writeCsv(const std::string& path) const;
+};
+
+/** Records the lifetime of the timer into a histogram, and counts an overrun
+	if it exceeds the budget (in nanoseconds, 0 = no budget) */
+class ScopedCallbackTimer
+{
+public:
+
+	ScopedCallbackTimer(LatencyHistogram& histogram_, std::atomic<uint64_t>* overruns_ = nullptr, int64_t budget_ = 0)
+		: histogram(histogram_), overruns(overruns_), budget(budget_), start(std::chrono::steady_clock::now()) { }
+
+	~ScopedCallbackTimer()
+	{
+		const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		histogram.record(elapsed);
+
+		if (overruns != nullptr && budget > 0 && elapsed > budget)
+			overruns->fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+
+	LatencyHistogram& histogram;
+	std::atomic<uint64_t>* overruns;
+	int64_t budget;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif
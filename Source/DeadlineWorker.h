@@ -0,0 +1,75 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DEADLINEWORKER_H_DEFINED
+#define DEADLINEWORKER_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+#include "BlockHandoff.h"
+
+class PythonProcessor;
+
+/**
+	Runs the Python side of each block on its own thread, so the processing
+	thread can stop waiting when the block's deadline passes, and never takes
+	the GIL itself. The worker copies the block to and from Python as well,
+	inside begin/endBufferAccess(). A late block keeps running here, and the
+	worker stays busy until it returns.
+*/
+class DeadlineWorker : public Thread
+{
+public:
+
+	/** Constructor */
+	DeadlineWorker(PythonProcessor* processor);
+
+	/** Destructor */
+	~DeadlineWorker() { }
+
+	/** Hands the current block to the worker. Returns false if it is still busy with a late block */
+	bool startBlock(AudioBuffer<float>& buffer) { return handoff.start(buffer); }
+
+	/** Waits up to timeoutMs for the current block. Returns false, abandoning the block,
+		if Python is still running it */
+	bool waitForBlock(int timeoutMs) { return handoff.wait(timeoutMs); }
+
+	/** True from startBlock() until Python returns from the block */
+	bool isBusy() const { return handoff.isBusy(); }
+
+	/** Called by the worker around its reads and writes of the AudioBuffer.
+		Returns false if the block was abandoned, in which case the buffer must not be touched */
+	bool beginBufferAccess() { return handoff.beginBufferAccess(); }
+	void endBufferAccess() { handoff.endBufferAccess(); }
+
+	/** Processes each block handed over by startBlock() */
+	void run() override;
+
+private:
+
+	PythonProcessor* processor;
+
+	BlockHandoff handoff;
+};
+
+#endif
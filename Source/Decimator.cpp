@@ -0,0 +1,159 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "Decimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/** Taps per output sample; each decimated sample uses tapsPerPhase * factor + 1 inputs */
+static const int tapsPerPhase = 16;
+
+Decimator::Decimator()
+	: numChannels(0),
+	  factor(1),
+	  historyLength(0),
+	  blockCapacity(0),
+	  outputCapacity(0),
+	  blockSamples(0),
+	  blockStart(0),
+	  nextSample(-1),
+	  numOutputSamples(0),
+	  firstOutputSample(0)
+{
+}
+
+void Decimator::prepare(int numChannels_, int factor_)
+{
+	numChannels = numChannels_;
+	factor = std::max(factor_, 1);
+
+	designFilter();
+
+	historyLength = (int) taps.size() - 1;
+	blockCapacity = 0;
+	outputCapacity = 0;
+
+	work.assign((size_t) historyLength * numChannels, 0.0f);
+	output.clear();
+	accumulator.assign(numChannels, 0.0f);
+
+	nextSample = -1;
+	numOutputSamples = 0;
+}
+
+void Decimator::designFilter()
+{
+	const int numTaps = tapsPerPhase * factor + 1;
+	const double cutoff = 0.45 / factor;
+	const double centre = (numTaps - 1) / 2.0;
+	const double pi = 3.14159265358979323846;
+
+	taps.resize(numTaps);
+	double sum = 0.0;
+
+	for (int k = 0; k < numTaps; ++k)
+	{
+		const double x = k - centre;
+		const double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * x) / (pi * x);
+		const double window = 0.42 - 0.5 * std::cos(2.0 * pi * k / (numTaps - 1))
+								   + 0.08 * std::cos(4.0 * pi * k / (numTaps - 1));
+
+		taps[k] = (float) (sinc * window);
+		sum += taps[k];
+	}
+
+	// Unity gain at DC
+	for (auto& tap : taps)
+		tap = (float) (tap / sum);
+}
+
+void Decimator::beginBlock(int numSamples, int64_t firstSampleNumber)
+{
+	// Filter state from before a discontinuity would smear into the new signal
+	if (firstSampleNumber != nextSample)
+		std::fill(work.begin(), work.begin() + (size_t) historyLength * numChannels, 0.0f);
+
+	if (numSamples > blockCapacity)
+	{
+		blockCapacity = numSamples;
+		work.resize((size_t) (historyLength + blockCapacity) * numChannels);
+
+		outputCapacity = blockCapacity / factor + 1;
+		output.resize((size_t) outputCapacity * numChannels);
+	}
+
+	blockSamples = numSamples;
+	blockStart = firstSampleNumber;
+}
+
+void Decimator::writeChannel(int channel, const float* data)
+{
+	float* dest = work.data() + (size_t) historyLength * numChannels + channel;
+
+	for (int i = 0; i < blockSamples; ++i)
+		dest[(size_t) i * numChannels] = data[i];
+}
+
+void Decimator::finishBlock()
+{
+	// First input sample in this block whose number is a multiple of the factor
+	const int64_t firstAligned = ((blockStart + factor - 1) / factor) * factor;
+
+	numOutputSamples = 0;
+	firstOutputSample = firstAligned / factor;
+
+	const int numTaps = (int) taps.size();
+	const float* tapData = taps.data();
+	float* acc = accumulator.data();
+
+	for (int64_t sample = firstAligned; sample < blockStart + blockSamples; sample += factor)
+	{
+		// Row of the newest input contributing to this output
+		const float* newest = work.data() + (size_t) (historyLength + (sample - blockStart)) * numChannels;
+
+		std::fill(acc, acc + numChannels, 0.0f);
+
+		for (int k = 0; k < numTaps; ++k)
+		{
+			const float tap = tapData[k];
+			const float* row = newest - (size_t) k * numChannels;
+
+			for (int c = 0; c < numChannels; ++c)
+				acc[c] += tap * row[c];
+		}
+
+		for (int c = 0; c < numChannels; ++c)
+			output[(size_t) c * outputCapacity + numOutputSamples] = acc[c];
+
+		++numOutputSamples;
+	}
+
+	// Keep the newest inputs as history for the next block
+	std::memmove(work.data(), work.data() + (size_t) blockSamples * numChannels,
+				 sizeof(float) * historyLength * numChannels);
+
+	nextSample = blockStart + blockSamples;
+}
@@ -0,0 +1,110 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DECIMATOR_H_DEFINED
+#define DECIMATOR_H_DEFINED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+	Anti-alias low-pass filter and decimator for all channels of a stream.
+
+	Only every factor-th output of the FIR is computed (the polyphase
+	saving). Samples are interleaved across channels, so the inner loop
+	runs over contiguous channels and is vectorised by the compiler.
+	Filter state is kept across blocks. Outputs are aligned to input sample
+	numbers that are multiples of the factor: output sample n is computed
+	when input sample n * factor arrives. The filter is linear phase, so it
+	describes the signal getDelay() input samples earlier, at input sample
+	n * factor - getDelay().
+
+	Blocks are passed with beginBlock() / writeChannel() / finishBlock().
+*/
+class Decimator
+{
+public:
+
+	/** Constructor */
+	Decimator();
+
+	/** Designs the filter and clears the state. Not real-time safe. */
+	void prepare(int numChannels, int factor);
+
+	/** Starts a block. The state is cleared if firstSampleNumber does not follow the previous block. */
+	void beginBlock(int numSamples, int64_t firstSampleNumber);
+
+	/** Copies one channel of the block started with beginBlock() */
+	void writeChannel(int channel, const float* data);
+
+	/** Filters the block and produces its decimated samples */
+	void finishBlock();
+
+	/** Decimated samples produced by the last block */
+	int getNumOutputSamples() const { return numOutputSamples; }
+
+	/** Decimated sample number of the first output of the last block */
+	int64_t getFirstOutputSample() const { return firstOutputSample; }
+
+	/** Decimated samples of one channel from the last block */
+	const float* getOutput(int channel) const { return output.data() + (size_t) channel * outputCapacity; }
+
+	int getFactor() const { return factor; }
+
+	/** Filter length in input samples */
+	int getNumTaps() const { return (int) taps.size(); }
+
+	/** Group delay of the filter in input samples, (taps - 1) / 2. A multiple of the factor */
+	int getDelay() const { return ((int) taps.size() - 1) / 2; }
+
+private:
+
+	/** Windowed-sinc low-pass with its cutoff just below the decimated Nyquist frequency */
+	void designFilter();
+
+	int numChannels;
+	int factor;
+
+	std::vector<float> taps;
+
+	/** (history + block) x channels, interleaved */
+	std::vector<float> work;
+	int historyLength;
+	int blockCapacity;
+
+	/** channels x outputCapacity */
+	std::vector<float> output;
+	int outputCapacity;
+
+	std::vector<float> accumulator;
+
+	int blockSamples;
+	int64_t blockStart;
+	int64_t nextSample;
+
+	int numOutputSamples;
+	int64_t firstOutputSample;
+};
+
+#endif
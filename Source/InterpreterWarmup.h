@@ -0,0 +1,55 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef INTERPRETERWARMUP_H_DEFINED
+#define INTERPRETERWARMUP_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+class PythonProcessor;
+
+/**
+	Imports the preloaded modules and the script off the message thread when
+	the plugin loads, so slow imports (numpy, scipy, torch...) do not freeze
+	the GUI. Later imports of the same modules find them in sys.modules.
+	signalThreadShouldExit() stops it after the import in progress.
+*/
+class InterpreterWarmup : public Thread
+{
+public:
+
+	/** Constructor */
+	InterpreterWarmup(PythonProcessor* processor);
+
+	/** Destructor */
+	~InterpreterWarmup() { }
+
+	/** Imports the modules once, then exits */
+	void run() override;
+
+private:
+
+	PythonProcessor* processor;
+};
+
+#endif
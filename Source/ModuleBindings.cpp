@@ -0,0 +1,180 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "ModuleBindings.h"
+#include "SosFilterBank.h"
+#include "NpyWriter.h"
+#include "NativeKernel.h"
+
+#include <pybind11/numpy.h>
+
+#include <filesystem>
+#include <memory>
+
+/** Builds a filter bank from an (n_sections x 6) array of scipy sos coefficients */
+static std::unique_ptr<SosFilterBank> createFilterBank(py::array_t<double, py::array::c_style | py::array::forcecast> sos, int numChannels)
+{
+	if (sos.ndim() != 2 || sos.shape(1) != 6 || sos.shape(0) == 0)
+		throw py::value_error("sos must have shape (n_sections, 6)");
+
+	if (numChannels <= 0)
+		throw py::value_error("num_channels must be positive");
+
+	return std::make_unique<SosFilterBank>(sos.data(), (int) sos.shape(0), numChannels);
+}
+
+/** Filters a writeable (channels x samples) float32 array in place, with the GIL released */
+static void filterInPlace(SosFilterBank& filterBank, py::array data)
+{
+	if (!py::isinstance<py::array_t<float>>(data) || data.ndim() != 2)
+		throw py::type_error("data must be a 2D float32 array");
+
+	if (data.shape(0) != filterBank.getNumChannels())
+		throw py::value_error("data must have one row per filter channel");
+
+	if (data.strides(1) != sizeof(float) || data.strides(0) % sizeof(float) != 0)
+		throw py::value_error("data rows must be contiguous");
+
+	float* samples = (float*) data.mutable_data();
+	const int numSamples = (int) data.shape(1);
+	const ptrdiff_t channelStride = data.strides(0) / (ptrdiff_t) sizeof(float);
+
+	py::gil_scoped_release release;
+	filterBank.process(samples, numSamples, channelStride);
+}
+
+/** Copy of the filter state, shaped (n_sections, 2, num_channels) */
+static py::array_t<double> getFilterState(SosFilterBank& filterBank)
+{
+	py::array_t<double> state({ filterBank.getNumSections(), 2, filterBank.getNumChannels() });
+	filterBank.getState(state.mutable_data());
+	return state;
+}
+
+/** Replaces the filter state with one of the same shape, e.g. another bank's */
+static void setFilterState(SosFilterBank& filterBank, py::array_t<double, py::array::c_style | py::array::forcecast> state)
+{
+	if (state.ndim() != 3 || state.shape(0) != filterBank.getNumSections() || state.shape(1) != 2
+		|| state.shape(2) != filterBank.getNumChannels())
+		throw py::value_error("state must have shape (n_sections, 2, num_channels)");
+
+	filterBank.setState(state.data());
+}
+
+/** Opens name (usually a relative path) inside directory, e.g. the directory passed to start_recording */
+static std::unique_ptr<NpyWriter> createNpyWriter(const std::string& directory, const std::string& name, size_t bufferSize)
+{
+	std::filesystem::path path = std::filesystem::path(directory) / name;
+
+	std::error_code ignored;
+	std::filesystem::create_directories(path.parent_path(), ignored);
+
+	auto writer = std::make_unique<NpyWriter>(path.string(), bufferSize);
+
+	if (!writer->isOpen())
+	{
+		PyErr_SetString(PyExc_OSError, writer->getError().c_str());
+		throw py::error_already_set();
+	}
+
+	return writer;
+}
+
+/** Appends an array's rows (along its first axis), copying it with the GIL released */
+static void writeRows(NpyWriter& writer, py::array data)
+{
+	if (data.ndim() == 0)
+		throw py::value_error("data must have at least one dimension; use data[None] to write a single row");
+
+	py::dtype dtype = data.dtype();
+
+	if (dtype.has_fields() || std::string("biufc").find(dtype.kind()) == std::string::npos)
+		throw py::type_error("only numeric arrays can be written");
+
+	const std::string descr = py::str(dtype.attr("str"));
+	const std::vector<int64_t> rowShape(data.shape() + 1, data.shape() + data.ndim());
+
+	// The first array sets the format of the file
+	if (!writer.hasFormat())
+		writer.setFormat(descr, (size_t) dtype.itemsize(), rowShape);
+	else if (descr != writer.getDescr() || rowShape != writer.getRowShape())
+		throw py::value_error("data must have the dtype and row shape of the first array written");
+
+	py::array contiguous = py::array::ensure(data, py::array::c_style);
+	bool written;
+
+	{
+		py::gil_scoped_release release;
+		written = writer.write(contiguous.data(), (size_t) contiguous.nbytes());
+	}
+
+	if (!written)
+	{
+		PyErr_SetString(PyExc_OSError, writer.getError().c_str());
+		throw py::error_already_set();
+	}
+}
+
+void setNativeKernel(NativeKernel& kernel, py::handle function, const std::string& signature)
+{
+	if (function.is_none())
+	{
+		kernel.clear();
+		return;
+	}
+
+	py::object address = py::hasattr(function, "address") ? function.attr("address") : py::reinterpret_borrow<py::object> (function);
+
+	if (!py::isinstance<py::int_>(address))
+		throw py::type_error("func must be a function address or have an address attribute, e.g. a numba cfunc");
+
+	if (!kernel.set((void*) address.cast<uintptr_t>(), signature))
+		throw py::value_error("unsupported signature '" + signature + "'; expected one of " + NativeKernel::getSupportedSignatures());
+}
+
+void bindNativeTypes(py::module_& module)
+{
+	py::class_<SosFilterBank> (module, "SosFilterBank")
+		.def(py::init(&createFilterBank), py::arg("sos"), py::arg("num_channels"))
+		.def("filter", &filterInPlace, py::arg("data"))
+		.def("reset", &SosFilterBank::reset)
+		.def_property("state", &getFilterState, &setFilterState)
+		.def_property_readonly("num_channels", &SosFilterBank::getNumChannels)
+		.def_property_readonly("num_sections", &SosFilterBank::getNumSections);
+
+	py::class_<NpyWriter> (module, "NpyWriter")
+		.def(py::init(&createNpyWriter), py::arg("directory"), py::arg("name"), py::arg("buffer_size") = 4 << 20)
+		.def("write", &writeRows, py::arg("data"))
+		.def("flush", &NpyWriter::flush, py::call_guard<py::gil_scoped_release>())
+		.def("close", &NpyWriter::close, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("path", &NpyWriter::getPath)
+		.def_property_readonly("bytes_written", &NpyWriter::getBytesWritten)
+		.def_property_readonly("rows_written", &NpyWriter::getRowsWritten)
+		.def_property_readonly("pending_bytes", &NpyWriter::getPendingBytes)
+		.def_property_readonly("rows_dropped", &NpyWriter::getRowsDropped)
+		.def_property_readonly("flush_count", &NpyWriter::getNumFlushes)
+		.def_property_readonly("last_flush_ms", &NpyWriter::getLastFlushMs)
+		.def_property_readonly("max_flush_ms", &NpyWriter::getMaxFlushMs);
+}
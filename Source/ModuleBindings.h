@@ -0,0 +1,43 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MODULEBINDINGS_H_DEFINED
+#define MODULEBINDINGS_H_DEFINED
+
+#include <pybind11/pybind11.h>
+
+#include <string>
+
+namespace py = pybind11;
+
+class NativeKernel;
+
+/** Adds the native helpers (SosFilterBank, NpyWriter) to the oe_pyprocessor module.
+	Shared by the plugin and the benchmark, which each define the module. */
+void bindNativeTypes(py::module_& module);
+
+/** Points kernel at function: an integer address, or an object with an address attribute
+	such as a numba cfunc. None clears the kernel. Raises TypeError or ValueError otherwise. */
+void setNativeKernel(NativeKernel& kernel, py::handle function, const std::string& signature);
+
+#endif
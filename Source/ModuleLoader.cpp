@@ -0,0 +1,47 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "ModuleLoader.h"
+#include "PythonProcessor.h"
+
+ModuleLoader::ModuleLoader(PythonProcessor* processor_)
+	: Thread("Python Module Loader"),
+	  processor(processor_)
+{
+}
+
+void ModuleLoader::run()
+{
+	{
+		py::gil_scoped_acquire acquire;
+		processor->loadPendingModule();
+	}
+
+	// The processing thread swaps the instance in at its next block and leaves the old one here
+	while (processor->isModuleSwapPending() && !threadShouldExit())
+		wait(10);
+
+	py::gil_scoped_acquire acquire;
+	processor->retireModule();
+}
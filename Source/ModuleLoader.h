@@ -0,0 +1,55 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MODULELOADER_H_DEFINED
+#define MODULELOADER_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+class PythonProcessor;
+
+/**
+	Reloads the script and builds and starts a new PyProcessor instance off
+	the message and processing threads, so a script can be reloaded during
+	acquisition. The processor swaps the new instance in at a block boundary,
+	then this thread stops and deletes the instance it replaced.
+*/
+class ModuleLoader : public Thread
+{
+public:
+
+	/** Constructor */
+	ModuleLoader(PythonProcessor* processor);
+
+	/** Destructor */
+	~ModuleLoader() { }
+
+	/** Loads the new version once, retires the old one after the swap, then exits */
+	void run() override;
+
+private:
+
+	PythonProcessor* processor;
+};
+
+#endif
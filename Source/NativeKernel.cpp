@@ -0,0 +1,165 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "NativeKernel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <thread>
+
+namespace
+{
+	typedef void (*VoidBlockKernel) (float**, int32_t, int32_t);
+	typedef int32_t (*IntBlockKernel) (float**, int32_t, int32_t);
+	typedef void (*VoidBlockSampleKernel) (float**, int32_t, int32_t, int64_t);
+	typedef int32_t (*IntBlockSampleKernel) (float**, int32_t, int32_t, int64_t);
+
+	void replaceAll(std::string& text, const std::string& from, const std::string& to)
+	{
+		for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+			text.replace(pos, from.size(), to);
+	}
+}
+
+NativeKernel::NativeKernel()
+	: entries {},
+	  current(nullptr),
+	  callsStarted(0),
+	  callsFinished(0)
+{
+}
+
+NativeKernel::Signature NativeKernel::parseSignature(const std::string& text)
+{
+	std::string normalized = text;
+	normalized.erase(std::remove_if(normalized.begin(), normalized.end(),
+									[] (char c) { return std::isspace((unsigned char) c) != 0; }),
+					 normalized.end());
+
+	replaceAll(normalized, "int32_t", "int32");
+	replaceAll(normalized, "int64_t", "int64");
+	replaceAll(normalized, "float32", "float");
+
+	if (normalized == "void(float**,int32,int32)")
+		return VOID_BLOCK;
+	if (normalized == "int32(float**,int32,int32)")
+		return INT_BLOCK;
+	if (normalized == "void(float**,int32,int32,int64)")
+		return VOID_BLOCK_SAMPLE;
+	if (normalized == "int32(float**,int32,int32,int64)")
+		return INT_BLOCK_SAMPLE;
+
+	return NONE;
+}
+
+const char* NativeKernel::getSupportedSignatures()
+{
+	return "void(float**, int32, int32), int32(float**, int32, int32), "
+		   "void(float**, int32, int32, int64), int32(float**, int32, int32, int64)";
+}
+
+bool NativeKernel::set(void* function_, const std::string& text)
+{
+	const Signature parsed = parseSignature(text);
+
+	if (function_ == nullptr || parsed == NONE)
+		return false;
+
+	// call() may be using the current entry, but not the other one
+	Entry* entry = current.load() == &entries[0] ? &entries[1] : &entries[0];
+	entry->function = function_;
+	entry->signature = parsed;
+
+	publish(entry);
+
+	return true;
+}
+
+void NativeKernel::clear()
+{
+	publish(nullptr);
+}
+
+void NativeKernel::takeFrom(NativeKernel& other)
+{
+	const Entry* taken = other.current.load();
+
+	if (taken != nullptr)
+	{
+		Entry* entry = current.load() == &entries[0] ? &entries[1] : &entries[0];
+		*entry = *taken;
+		publish(entry);
+	}
+	else
+	{
+		publish(nullptr);
+	}
+
+	other.clear();
+}
+
+void NativeKernel::publish(const Entry* entry)
+{
+	current.store(entry);
+
+	// A call counted as started may have read the previous entry; later ones read this one
+	const uint64_t started = callsStarted.load();
+
+	while (callsFinished.load() < started)
+		std::this_thread::yield();
+}
+
+bool NativeKernel::call(float** channels, int numChannels, int numSamples, int64_t sampleNumber)
+{
+	callsStarted.fetch_add(1);
+
+	const Entry* entry = current.load();
+	bool succeeded = true;
+
+	if (entry != nullptr)
+	{
+		switch (entry->signature)
+		{
+			case VOID_BLOCK:
+				((VoidBlockKernel) entry->function) (channels, numChannels, numSamples);
+				break;
+			case INT_BLOCK:
+				succeeded = ((IntBlockKernel) entry->function) (channels, numChannels, numSamples) == 0;
+				break;
+			case VOID_BLOCK_SAMPLE:
+				((VoidBlockSampleKernel) entry->function) (channels, numChannels, numSamples, sampleNumber);
+				break;
+			case INT_BLOCK_SAMPLE:
+				succeeded = ((IntBlockSampleKernel) entry->function) (channels, numChannels, numSamples, sampleNumber) == 0;
+				break;
+			default:
+				break;
+		}
+	}
+
+	callsFinished.fetch_add(1);
+
+	return succeeded;
+}
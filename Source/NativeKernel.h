@@ -0,0 +1,109 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef NATIVEKERNEL_H_DEFINED
+#define NATIVEKERNEL_H_DEFINED
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+	A compiled function (numba @cfunc, Cython, ctypes...) registered by a
+	script to process each block in place of its Python process() method.
+	It is called with raw channel pointers and without the GIL.
+
+	Supported signatures, where channels points to numChannels pointers to
+	numSamples float32 samples, and sampleNumber is the block's first sample:
+
+		void(float**, int32, int32)           kernel(channels, numChannels, numSamples)
+		int32(float**, int32, int32)
+		void(float**, int32, int32, int64)    kernel(channels, numChannels, numSamples, sampleNumber)
+		int32(float**, int32, int32, int64)
+
+	A kernel returning int32 reports an error with any non-zero value.
+
+	call() takes no lock: the function and signature are swapped as one
+	pointer, and set() / clear() / takeFrom() return only once a call that
+	may still use the old function has finished, so its owner can then be
+	released. call() must only be made from one thread at a time, and the
+	other methods must not run concurrently with each other (the GIL).
+*/
+class NativeKernel
+{
+public:
+
+	/** Constructor */
+	NativeKernel();
+
+	/** Sets the kernel. Returns false if the signature is not supported or the address is null */
+	bool set(void* function, const std::string& signature);
+
+	/** Removes the kernel */
+	void clear();
+
+	/** Replaces this kernel with other's, leaving other empty */
+	void takeFrom(NativeKernel& other);
+
+	/** True if a kernel is set */
+	bool isSet() const { return current.load() != nullptr; }
+
+	/** Calls the kernel. Returns false if it reported an error */
+	bool call(float** channels, int numChannels, int numSamples, int64_t sampleNumber);
+
+	/** The signatures accepted by set(), for error messages */
+	static const char* getSupportedSignatures();
+
+private:
+
+	enum Signature
+	{
+		NONE = 0,
+		VOID_BLOCK,
+		INT_BLOCK,
+		VOID_BLOCK_SAMPLE,
+		INT_BLOCK_SAMPLE
+	};
+
+	/** Matches a signature string, ignoring spaces and accepting int32_t / int64_t / float32 */
+	static Signature parseSignature(const std::string& signature);
+
+	struct Entry
+	{
+		void* function;
+		Signature signature;
+	};
+
+	/** Makes entry (or none) the kernel, then waits for calls still using the previous one */
+	void publish(const Entry* entry);
+
+	/** Two entries, so a new kernel is written to the one call() cannot be using */
+	Entry entries[2];
+	std::atomic<const Entry*> current;
+
+	std::atomic<uint64_t> callsStarted;
+	std::atomic<uint64_t> callsFinished;
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "NpyWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+NpyWriter::NpyWriter(const std::string& path_, size_t bufferBytes_)
+	: path(path_),
+	  rowBytes(0),
+	  bufferBytes(std::max(bufferBytes_, (size_t) 4096)),
+	  flushing(false),
+	  closing(false),
+	  failed(false),
+	  bytesWritten(0),
+	  pendingBytes(0),
+	  droppedBytes(0),
+	  numFlushes(0),
+	  lastFlushNs(0),
+	  maxFlushNs(0)
+{
+	file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+
+	// An empty float64 array until the first rows are written
+	if (!file.is_open() || !writeHeader())
+	{
+		error = "Unable to open " + path + ": " + std::strerror(errno);
+		file.close();
+		return;
+	}
+
+	front.reserve(bufferBytes);
+	back.reserve(bufferBytes);
+
+	thread = std::thread(&NpyWriter::run, this);
+}
+
+NpyWriter::~NpyWriter()
+{
+	close();
+}
+
+void NpyWriter::setFormat(const std::string& descr_, size_t itemSize, const std::vector<int64_t>& rowShape_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	descr = descr_;
+	rowShape = rowShape_;
+	rowBytes = itemSize;
+
+	for (auto dim : rowShape)
+		rowBytes *= (size_t) dim;
+
+	// write() only copies whole rows, and never reallocates the buffers
+	if (rowBytes > bufferBytes)
+	{
+		bufferBytes = rowBytes;
+		front.reserve(bufferBytes);
+		back.reserve(bufferBytes);
+	}
+}
+
+bool NpyWriter::write(const void* data, size_t numBytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (failed || closing || !thread.joinable())
+		return false;
+
+	const char* rows = (const char*) data;
+	const size_t step = std::max(rowBytes, (size_t) 1);
+
+	while (numBytes > 0)
+	{
+		// Whole rows that fit in the front buffer without growing it
+		const size_t numCopied = std::min(numBytes, (bufferBytes - front.size()) / step * step);
+
+		front.insert(front.end(), rows, rows + numCopied);
+		pendingBytes += (int64_t) numCopied;
+		rows += numCopied;
+		numBytes -= numCopied;
+
+		// Hand the buffer over once no further row fits; if the back buffer is still busy, drop the rest
+		if (front.size() + step > bufferBytes && !swapBuffers())
+			break;
+	}
+
+	droppedBytes += (int64_t) numBytes;
+
+	return true;
+}
+
+bool NpyWriter::swapBuffers()
+{
+	// The background thread still owns the back buffer
+	if (flushing || !back.empty())
+		return false;
+
+	std::swap(front, back);
+	condition.notify_all();
+	return true;
+}
+
+void NpyWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (!thread.joinable())
+		return;
+
+	condition.wait(lock, [this] { return back.empty() && !flushing; });
+
+	if (front.empty())
+		return;
+
+	swapBuffers();
+	condition.wait(lock, [this] { return back.empty() && !flushing; });
+}
+
+void NpyWriter::close()
+{
+	if (!thread.joinable())
+		return;
+
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+
+	condition.notify_all();
+	thread.join();
+	file.close();
+}
+
+std::string NpyWriter::getError() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (error.empty() && closing)
+		return "The file has been closed";
+
+	return error;
+}
+
+void NpyWriter::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		condition.wait(lock, [this] { return !back.empty() || closing; });
+
+		// close() flushes everything before it sets closing
+		if (back.empty())
+			break;
+
+		flushing = true;
+		lock.unlock();
+
+		const auto start = std::chrono::steady_clock::now();
+
+		file.write(back.data(), (std::streamsize) back.size());
+		bool ok = file.good();
+
+		if (ok)
+		{
+			bytesWritten += (int64_t) back.size();
+			ok = writeHeader();
+		}
+
+		const int64_t flushNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		lastFlushNs = flushNs;
+		maxFlushNs = std::max(maxFlushNs.load(), flushNs);
+		numFlushes++;
+
+		lock.lock();
+
+		if (!ok && !failed)
+		{
+			error = "Unable to write to " + path + ": " + std::strerror(errno);
+			failed = true;
+		}
+
+		pendingBytes -= (int64_t) back.size();
+		back.clear();
+		flushing = false;
+		condition.notify_all();
+	}
+}
+
+bool NpyWriter::writeHeader()
+{
+	std::string shape = "(" + std::to_string(getRowsWritten());
+
+	for (auto dim : rowShape)
+		shape += ", " + std::to_string(dim);
+
+	shape += rowShape.empty() ? ",)" : ")";
+
+	std::string dict = "{'descr': '" + (descr.empty() ? std::string("<f8") : descr)
+					 + "', 'fortran_order': False, 'shape': " + shape + ", }";
+
+	// Format version 1.0: the dictionary is padded with spaces to the reserved size, ending in a newline
+	const size_t dictBytes = headerBytes - 10;
+
+	if (dict.size() + 1 > dictBytes)
+	{
+		errno = EOVERFLOW;
+		return false;
+	}
+
+	dict.append(dictBytes - dict.size() - 1, ' ');
+	dict += '\n';
+
+	const char preamble[10] = { '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char) (dictBytes & 0xff), (char) (dictBytes >> 8) };
+
+	file.seekp(0);
+	file.write(preamble, sizeof(preamble));
+	file.write(dict.data(), (std::streamsize) dict.size());
+	file.seekp(0, std::ios::end);
+
+	// The shape is written after the rows, so it never covers rows missing from the file
+	file.flush();
+
+	return file.good();
+}
@@ -0,0 +1,141 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef NPYWRITER_H_DEFINED
+#define NPYWRITER_H_DEFINED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+	Appends rows to a .npy file without blocking the caller on disk I/O.
+
+	write() copies the rows into the front of two preallocated buffers. Once
+	it is full the buffers are swapped and a background thread appends the
+	back buffer to the file, then rewrites the header's shape in place. The
+	file is a valid .npy (np.load(path, mmap_mode="r")) after every flush.
+
+	The dtype and row shape are set by the first write. write() never
+	allocates: if the background thread is still flushing when the front
+	buffer is full, the rows that do not fit are dropped and counted rather
+	than making the caller wait.
+
+	close() and the destructor join the background thread, so they must be
+	called outside process() (e.g. in stop_recording), never on the audio thread.
+*/
+class NpyWriter
+{
+public:
+
+	/** Constructor. Opens the file, replacing any existing one */
+	NpyWriter(const std::string& path, size_t bufferBytes);
+
+	/** Destructor. Closes the file */
+	~NpyWriter();
+
+	/** True if the file was opened and no write has failed */
+	bool isOpen() const { return file.is_open() && !failed; }
+
+	/** Sets the numpy dtype string (e.g. "<f4"), item size and trailing dimensions of every row.
+		Called once, before the first write. The buffers are enlarged to hold at least one row */
+	void setFormat(const std::string& descr, size_t itemSize, const std::vector<int64_t>& rowShape);
+
+	bool hasFormat() const { return !descr.empty(); }
+	const std::string& getDescr() const { return descr; }
+	const std::vector<int64_t>& getRowShape() const { return rowShape; }
+
+	/** Copies whole rows, contiguous in memory, dropping those that do not fit in the buffer.
+		Returns false if an earlier flush failed */
+	bool write(const void* data, size_t numBytes);
+
+	/** Writes everything buffered so far to the file, and waits until it has been written */
+	void flush();
+
+	/** Flushes, stops the background thread and closes the file. Not from the audio thread */
+	void close();
+
+	/** File path, and the message of the last I/O error */
+	const std::string& getPath() const { return path; }
+	std::string getError() const;
+
+	/** Metrics, updated by the background thread */
+	int64_t getBytesWritten() const { return bytesWritten; }
+	int64_t getRowsWritten() const { return rowBytes > 0 ? bytesWritten / (int64_t) rowBytes : 0; }
+	int64_t getPendingBytes() const { return pendingBytes; }
+	int64_t getRowsDropped() const { return rowBytes > 0 ? droppedBytes / (int64_t) rowBytes : 0; }
+	int64_t getNumFlushes() const { return numFlushes; }
+	double getLastFlushMs() const { return lastFlushNs / 1.0e6; }
+	double getMaxFlushMs() const { return maxFlushNs / 1.0e6; }
+
+private:
+
+	/** Appends back buffers to the file until close() */
+	void run();
+
+	/** Rewrites the header with the number of rows written so far. Background thread only */
+	bool writeHeader();
+
+	/** Swaps the buffers if the back buffer is free. mutex must be held */
+	bool swapBuffers();
+
+	/** Bytes reserved for the header, so it can be rewritten in place as the file grows */
+	static const size_t headerBytes = 256;
+
+	std::string path;
+	std::ofstream file;
+
+	std::string descr;
+	std::vector<int64_t> rowShape;
+	size_t rowBytes;
+
+	/** Filled by write(), and appended to the file by the background thread. Both keep bufferBytes reserved */
+	std::vector<char> front;
+	std::vector<char> back;
+	size_t bufferBytes;
+
+	/** True while the background thread is writing the back buffer */
+	bool flushing;
+	bool closing;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
+
+	std::string error;
+	std::atomic<bool> failed;
+
+	std::atomic<int64_t> bytesWritten;
+	std::atomic<int64_t> pendingBytes;
+	std::atomic<int64_t> droppedBytes;
+	std::atomic<int64_t> numFlushes;
+	std::atomic<int64_t> lastFlushNs;
+	std::atomic<int64_t> maxFlushNs;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "OutputEventQueue.h"
+
+OutputEventQueue::OutputEventQueue(int capacity)
+	: writePosition(0),
+	  readPosition(0),
+	  numDropped(0)
+{
+	size_t size = 2;
+
+	while (size < (size_t) capacity)
+		size <<= 1;
+
+	slots.reset(new Slot[size]);
+	mask = size - 1;
+
+	// A slot is free for the producer at position p when its sequence equals p
+	for (size_t i = 0; i < size; ++i)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool OutputEventQueue::push(const OutputEvent& event)
+{
+	size_t position = writePosition.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		Slot& slot = slots[position & mask];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		const ptrdiff_t difference = (ptrdiff_t) sequence - (ptrdiff_t) position;
+
+		if (difference == 0)
+		{
+			if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.event = event;
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The consumer has not freed this slot yet
+			++numDropped;
+			return false;
+		}
+		else
+		{
+			// Another producer claimed this position
+			position = writePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool OutputEventQueue::pop(OutputEvent& event)
+{
+	Slot& slot = slots[readPosition & mask];
+
+	if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+		return false;
+
+	event = slot.event;
+	slot.sequence.store(readPosition + mask + 1, std::memory_order_release);
+	++readPosition;
+
+	return true;
+}
@@ -0,0 +1,90 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OUTPUTEVENTQUEUE_H_DEFINED
+#define OUTPUTEVENTQUEUE_H_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/** TTL event emitted by the script, to be added to the output at its sample number */
+struct OutputEvent
+{
+	uint8_t line;
+	bool state;
+
+	/** Stream that sampleNumber counts samples of, or 0 if sampleNumber is an
+		offset from the start of the block that adds the event */
+	uint16_t streamId;
+
+	/** Full-rate sample number of the event */
+	int64_t sampleNumber;
+};
+
+/**
+	Preallocated multi-producer / single-consumer ring of OutputEvents.
+
+	Any thread running Python (processing thread, async worker, stream shards)
+	may push; only the processing thread pops. Each slot carries a sequence
+	number so producers claim slots with a single compare-and-swap and no
+	locks are taken on either side.
+*/
+class OutputEventQueue
+{
+public:
+
+	/** Constructor. Capacity is rounded up to a power of two. */
+	explicit OutputEventQueue(int capacity = 4096);
+
+	/** Adds an event. Returns false, and counts the event as dropped, if the ring is full. */
+	bool push(const OutputEvent& event);
+
+	/** Removes the oldest event. Returns false if the ring is empty. Consumer only. */
+	bool pop(OutputEvent& event);
+
+	/** Number of events dropped because the ring was full */
+	int64_t getNumDropped() const { return numDropped.load(); }
+
+	/** Restarts the dropped count, e.g. when acquisition starts */
+	void resetNumDropped() { numDropped.store(0); }
+
+private:
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		OutputEvent event;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+
+	std::atomic<size_t> writePosition;
+	size_t readPosition;
+
+	std::atomic<int64_t> numDropped;
+};
+
+#endif
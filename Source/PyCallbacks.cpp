@@ -0,0 +1,51 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "PyCallbacks.h"
+
+static py::object getHook(py::object& instance, const char* name)
+{
+	if (py::hasattr(instance, name))
+		return instance.attr(name);
+
+	return py::object();
+}
+
+void PyCallbacks::resolve(py::object& instance)
+{
+	process = instance.attr("process");
+	handleTTLEvent = getHook(instance, "handle_ttl_event");
+	handleTTLEvents = getHook(instance, "handle_ttl_events");
+	handleSpike = getHook(instance, "handle_spike");
+	handleSpikes = getHook(instance, "handle_spikes");
+	startAcquisition = getHook(instance, "start_acquisition");
+	stopAcquisition = getHook(instance, "stop_acquisition");
+	startRecording = getHook(instance, "start_recording");
+	stopRecording = getHook(instance, "stop_recording");
+}
+
+void PyCallbacks::clear()
+{
+	*this = PyCallbacks();
+}
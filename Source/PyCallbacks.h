@@ -0,0 +1,88 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PYCALLBACKS_H_DEFINED
+#define PYCALLBACKS_H_DEFINED
+
+#include <pybind11/pybind11.h>
+
+#include <array>
+
+namespace py = pybind11;
+
+#if PY_VERSION_HEX < 0x03090000
+#define PyObject_Vectorcall _PyObject_Vectorcall
+#endif
+
+/**
+	Bound methods of a PyProcessor instance, looked up once when the
+	instance is created so that each call skips the attribute lookup.
+
+	Hooks the module does not define are left empty, so they can be
+	tested with operator bool. Must be resolved, called and cleared
+	with the GIL held.
+*/
+struct PyCallbacks
+{
+	py::object process;
+	py::object handleTTLEvent;
+	py::object handleTTLEvents;
+	py::object handleSpike;
+	py::object handleSpikes;
+	py::object startAcquisition;
+	py::object stopAcquisition;
+	py::object startRecording;
+	py::object stopRecording;
+
+	/** Looks up every hook on a new PyProcessor instance. Throws if process() is missing. */
+	void resolve(py::object& instance);
+
+	/** Drops the references to the bound methods */
+	void clear();
+
+	/** True if the instance handles TTL events or spikes */
+	bool hasEventHooks() const { return handleTTLEvent || handleTTLEvents || handleSpike || handleSpikes; }
+
+	/** Calls a bound method through the vectorcall protocol, without building an argument tuple */
+	template <typename... Args>
+	static py::object call(const py::object& method, Args&&... args)
+	{
+		std::array<py::object, sizeof...(Args)> converted { { py::cast(std::forward<Args>(args))... } };
+
+		// The extra leading slot lets the bound method prepend self in place
+		PyObject* argv[sizeof...(Args) + 1] = { nullptr };
+
+		for (size_t i = 0; i < converted.size(); ++i)
+			argv[i + 1] = converted[i].ptr();
+
+		PyObject* result = PyObject_Vectorcall(method.ptr(), argv + 1,
+											   sizeof...(Args) | PY_VECTORCALL_ARGUMENTS_OFFSET, nullptr);
+
+		if (result == nullptr)
+			throw py::error_already_set();
+
+		return py::reinterpret_steal<py::object>(result);
+	}
+};
+
+#endif
@@ -23,19 +23,68 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <filesystem>
+#include <optional>
 
 #include "PythonProcessor.h"
 
 namespace py = pybind11;
 
+/** Where the sample offsets passed to add_python_event() start, for the Python call running on this thread */
+struct EventOrigin
+{
+    const PythonProcessor* processor = nullptr;
+    uint16 streamId = 0;
+
+    /** Full-rate sample number of offset 0, and full-rate samples per offset */
+    int64 firstSample = 0;
+    int decimation = 1;
+};
+
+static thread_local EventOrigin eventOrigin;
+
+/** Sets the origin of event offsets for the Python calls made in its scope */
+class ScopedEventOrigin
+{
+public:
+    ScopedEventOrigin(const PythonProcessor* processor, uint16 streamId, int64 firstSample, int decimation)
+        : previous(eventOrigin)
+    {
+        eventOrigin = { processor, streamId, firstSample, decimation };
+    }
+
+    ~ScopedEventOrigin() { eventOrigin = previous; }
+
+private:
+    EventOrigin previous;
+};
+
+/** An event at sampleOffset from the origin of the Python call running on this thread */
+static OutputEvent makeOutputEvent(const PythonProcessor* processor, int line, bool state, int sampleOffset)
+{
+    // Threads started by the script have no block to count from
+    if (eventOrigin.processor != processor)
+        return { (uint8) line, state, 0, sampleOffset };
+
+    return { (uint8) line, state, eventOrigin.streamId,
+             eventOrigin.firstSample + (int64) sampleOffset * eventOrigin.decimation };
+}
+
 PYBIND11_EMBEDDED_MODULE(oe_pyprocessor, module){
 
     py::class_<PythonProcessor> (module, "PythonProcessor")
-        .def("add_python_event", &PythonProcessor::addPythonEvent);
+        .def("add_python_event", &PythonProcessor::addPythonEvent,
+             py::arg("line"), py::arg("state"), py::arg("sample_offset") = 0)
+        .def("add_python_events", &PythonProcessor::addPythonEvents,
+             py::arg("lines"), py::arg("states"), py::arg("sample_offsets") = py::none())
+        .def("register_native_process", &PythonProcessor::registerNativeProcess,
+             py::arg("func"), py::arg("signature") = "void(float**, int32, int32)");
+
+    bindNativeTypes(module);
 }
 
 PythonProcessor::PythonProcessor()
-    : GenericProcessor("Python Processor")
+    : GenericProcessor("Python Processor"),
+      blockRunner(callbackStats, sampleConverter, blockArrays)
 {
     pyModule = nullptr;
     pyObject = nullptr;
@@ -44,24 +93,183 @@ PythonProcessor::PythonProcessor()
     moduleName = "";
     editorPtr = NULL;
     currentStream = 0;
+    outputStream = 0;
+    exportStream = 0;
+    exportEnabled = false;
+    blockEventsRead = false;
+    exportEventsOnly = false;
+    zeroCopy = false;
+    viewKept = false;
+    asyncMode = false;
+    multiStream = false;
+    outOfProcess = false;
+    saveLatencyStats = false;
+    readOnly = false;
+    windowSize = 0;
+    windowHop = 0;
+    decimationFactor = 1;
+    scriptReadOnly = false;
+    numStreamWorkers = 0;
+    queueDepth = 16;
+    overflowPolicy = BlockQueue::DROP_OLDEST;
+    deadlinePolicy = WAIT_FOR_PYTHON;
+    deadlinePercent = 100;
+    maxMissedBlocks = 0;
+    consecutiveMisses = 0;
+    mainThreadState = nullptr;
+    pendingObject = nullptr;
+    pendingModuleReady = false;
+    retiredObject = nullptr;
+    loadingPendingModule = false;
+    asyncBlockIndex = 0;
+    queuedBlockIndex = 0;
+    queuedBlockSamples = 0;
+    queuedBlockStream = 0;
+    queuedBlockFirstSample = 0;
+    eventBlockSample = 0;
+    lateWorkerBlockSample = 0;
+    warmupPending = false;
+    warmupActive = false;
+    warmupRestart = false;
+    warmupGeneration = 0;
+    acquiring = false;
+    warmupSeconds = 0.0;
+    aliveToken = std::make_shared<bool>(true);
 
     addStringParameter(Parameter::GLOBAL_SCOPE, "python_home", "Path to python home", String());
+    // Added before script_path, so a loaded signal chain restores it before the warm-up starts
+    addStringParameter(Parameter::GLOBAL_SCOPE,
+        "preload_modules", "Modules imported in the background when a script is loaded, e.g. numpy, scipy.signal",
+        "numpy", true);
     addStringParameter(Parameter::GLOBAL_SCOPE, "script_path", "Path to python script", String(), true);
     addIntParameter(Parameter::GLOBAL_SCOPE,
         "current_stream", "Currently selected stream",
         0, 0, 200000);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "zero_copy", "Pass the signal chain buffer to Python without copying (the array must not be kept after process)",
+        false, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "async_mode", "Run Python on a worker thread instead of the processing thread (read-only data)",
+        false, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "out_of_process", "Run the script in a separate Python process",
+        false, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "multi_stream", "Pass every data stream to Python in a single call",
+        false, true);
+    addStringParameter(Parameter::GLOBAL_SCOPE,
+        "selected_channels", "Channels of the selected stream passed to Python, e.g. 1-4,9 (empty = all, or as declared by the script)",
+        String(), true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "window_size", "Pass fixed windows of this many samples to Python instead of blocks (0 = blocks)",
+        0, 0, 1048576, true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "window_hop", "Samples between the starts of consecutive windows (0 = window size, no overlap)",
+        0, 0, 1048576, true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "decimation", "Low-pass filter and downsample the data passed to Python by this factor (1 = full rate)",
+        1, 1, 64, true);
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+        "dtype", "Data type of the arrays passed to Python",
+        { "float32", "float16", "int16" }, 0, true);
+    addFloatParameter(Parameter::GLOBAL_SCOPE,
+        "int16_scale", "Value of one integer step when the data is passed as int16",
+        0.195f, 0.0001f, 1000.0f, 0.0001f, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "read_only", "Pass read-only data to Python and skip writing it back",
+        false, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "save_latency", "Write Python callback latencies to a CSV file when acquisition stops",
+        false);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "stream_workers", "Number of threads sharing the streams in multi-stream mode (0 = no extra threads)",
+        0, 0, 64, true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "queue_depth", "Number of blocks that can wait for the Python worker",
+        16, 1, 1024, true);
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+        "overflow_policy", "What to do when the Python worker falls behind (Block waits up to 2 ms, then drops the newest)",
+        { "Drop oldest", "Drop newest", "Block" }, 0, true);
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+        "deadline_policy", "What to do with blocks Python has not finished by their deadline",
+        { "Wait for Python", "Pass through", "Reuse last output" }, 0, true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "deadline_percent", "Deadline for Python, as a percentage of the block duration",
+        100, 10, 1000, true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "max_missed_blocks", "Stop the script after this many consecutive blocks without Python output (0 = never)",
+        0, 0, 100000, true);
+    addBooleanParameter(Parameter::GLOBAL_SCOPE,
+        "export_stream", "Publish the selected stream and its events to shared memory for other local processes",
+        false, true);
+    addStringParameter(Parameter::GLOBAL_SCOPE,
+        "export_name", "Name of the shared memory segment the stream is published to",
+        "oe_python_stream", true);
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+        "export_seconds", "Seconds of data kept in the shared memory ring buffer (at most 256 MB)",
+        2, 1, 600, true);
+
+    asyncWorker = std::make_unique<AsyncWorker>(this, &blockQueue);
+    deadlineWorker = std::make_unique<DeadlineWorker>(this);
+    moduleLoader = std::make_unique<ModuleLoader>(this);
+    warmupThread = std::make_unique<InterpreterWarmup>(this);
+    workerProcess = std::make_unique<WorkerProcess>();
 }
 
 PythonProcessor::~PythonProcessor()
 {
+    blockQueue.close();
+    deadlineEvents.close();
+    asyncWorker->stopThread(1000);
+    deadlineWorker->stopThread(1000);
+    moduleLoader->signalThreadShouldExit();
+    moduleLoader->waitForThreadToExit(10000);
+
+    // Imports cannot be interrupted, and must finish before the interpreter shuts down
+    aliveToken.reset();
+    warmupThread->signalThreadShouldExit();
+    warmupThread->waitForThreadToExit(-1);
+
+    for (auto shard : streamShards)
+        shard->stopThread(1000);
+
+    workerProcess->shutdown();
+
     if(Py_IsInitialized() > 0)
     {
         {
+            py::gil_scoped_acquire acquire;
+            clearStreamShards();
+            streamBlocks.clear();
+            callbacks.clear();
+            pendingCallbacks.clear();
+            delete pendingObject;
+            retiredCallbacks.clear();
+            retiredKernelOwner = py::object();
+            delete retiredObject;
+            queuedBlocks = py::object();
+            nativeKernel.clear();
+            pendingKernel.clear();
+            nativeKernelOwner = py::object();
+            pendingKernelOwner = py::object();
+            spikeBatch.clear();
+            ttlBatch.clear();
+            blockArrays.clear();
+            windowArrays.clear();
+            spikeArrays.clear();
+            outputArrays.clear();
+            electrodeTable = py::object();
+            eventChannelTable = py::object();
             delete pyModule;
             delete pyObject;
-            py::gil_scoped_release release;
         }
-        py::finalize_interpreter();
+
+        // Only the processor that started the interpreter shuts it down
+        if (mainThreadState != nullptr)
+        {
+            PyEval_RestoreThread(mainThreadState);
+            py::finalize_interpreter();
+        }
     }
 }
 
@@ -79,6 +287,25 @@ void PythonProcessor::updateSettings()
     if (getDataStreams().size() == 0)
         currentStream = 0;
 
+    // Channels computed by the script are appended to the selected stream
+    outputChannelNames = getScriptOutputChannels();
+    outputStream = outputChannelNames.size() > 0 ? currentStream : 0;
+
+    for (auto& name : outputChannelNames)
+    {
+        ContinuousChannel::Settings outputChannelSettings{
+            ContinuousChannel::Type::AUX,
+            name,
+            "Output channel computed by " + String(moduleName),
+            "pythonprocessor.output",
+            1.0f,
+            getDataStream(outputStream)
+        };
+
+        continuousChannels.add(new ContinuousChannel(outputChannelSettings));
+        continuousChannels.getLast()->addProcessor(processorInfo.get());
+    }
+
     localEventChannels.clear();
 
     for (auto stream : getDataStreams())
@@ -102,6 +329,16 @@ void PythonProcessor::updateSettings()
         localEventChannels[streamId] = eventChannels.getLast();
 
     }
+
+    if (Py_IsInitialized() > 0)
+    {
+        py::gil_scoped_acquire acquire;
+        updateChannelTables();
+    }
+
+    // Stream layout is part of the module's constructor arguments in multi-stream mode
+    if (multiStream && moduleReady)
+        initModule();
 }
 
 void PythonProcessor::initialize(bool signalChainIsLoading)
@@ -110,221 +347,1988 @@ void PythonProcessor::initialize(bool signalChainIsLoading)
        && Py_IsInitialized() == 0)
     {
         initInterpreter();
+
+        if (Py_IsInitialized() > 0)
+            startWarmup();
     }
 }
 
 void PythonProcessor::process(AudioBuffer<float>& buffer)
 {
+    blockEventsRead = false;
+
+    processPython(buffer);
+
+    // Published as the stream leaves the plugin, whether or not Python is running
+    if (streamExporter.isOpen())
+    {
+        // Blocks that skipped Python (stopped script, late deadline, worker restart)
+        if (!blockEventsRead)
+        {
+            exportEventsOnly = true;
+            checkForEvents(true);
+            exportEventsOnly = false;
+        }
+
+        exportBlock(buffer);
+    }
+}
+
+void PythonProcessor::readBlockEvents()
+{
+    checkForEvents(true);
+    blockEventsRead = true;
+}
+
+void PythonProcessor::exportBlock(AudioBuffer<float>& buffer)
+{
+    const int numSamples = getNumSamplesInBlock(exportStream);
+
+    if (numSamples == 0)
+        return;
+
+    streamExporter.beginBlock(numSamples, getFirstSampleNumberForBlock(exportStream));
+
+    for (int i = 0; i < streamExporter.getNumChannels(); ++i)
+        streamExporter.writeChannel(i, buffer.getReadPointer(getGlobalChannelIndex(exportStream, i)));
+
+    streamExporter.finishBlock();
+}
+
+void PythonProcessor::processPython(AudioBuffer<float>& buffer)
+{
+    // A module reloaded during acquisition takes over at the start of a block, even if the
+    // previous version stopped on an exception. Async and late deadline blocks swap on the worker
+    if (pendingModuleReady && !outOfProcess && !asyncMode && !deadlineWorker->isBusy())
+        applyPendingModule();
+
+    // Whatever the buffer held before, until Python writes to them
+    if (outputStream > 0)
+        clearOutputChannels(buffer);
+
     if( !moduleReady )
         return;
 
-    checkForEvents(true);
+    if (outOfProcess)
+    {
+        processInWorkerProcess(buffer);
+        return;
+    }
+
+    if (nativeKernel.isSet() && canUseNativeKernel())
+    {
+        processNativeKernel(buffer);
+        return;
+    }
+
+    if (isDeadlineActive())
+    {
+        processWithDeadline(buffer);
+        return;
+    }
+
+    // In async mode the worker thread owns the interpreter, so blocks and
+    // events are only queued here and the GIL is never taken
+    std::optional<py::gil_scoped_acquire> acquire;
+
+    if (!asyncMode)
+        acquire.emplace();
 
-    int64 sampleNum = getFirstSampleNumberForBlock(currentStream);
+    // Offsets of events emitted from the event hooks count from the start of this block
+    eventBlockSample = getFirstSampleNumberForBlock(currentStream);
+    ScopedEventOrigin origin(this, currentStream, eventBlockSample, getDecimation(currentStream));
+
+    readBlockEvents();
+
+    if (!asyncMode)
+        flushEventBatches();
+
+    streamBlocks.clear();
 
     for (auto stream : getDataStreams())
     {
+        const uint16 streamId = stream->getStreamId();
+
+        // Stream shards gather their own streams
+        if ((!multiStream && streamId != currentStream) || streamShards.size() > 0)
+            continue;
+
+        int numSamples = getNumSamplesInBlock(streamId);
+        int64 firstSample = getFirstSampleNumberForBlock(streamId);
+        const int numChannels = getNumBlockChannels(streamId);
+
+        // Only for blocks bigger than 0
+        if (numSamples == 0)
+            continue;
+
+        // Python sees the decimated signal, while the full-rate buffer passes downstream untouched
+        if (!decimateBlock(buffer, streamId, numChannels, numSamples, firstSample))
+            continue;
 
-        if (stream->getStreamId() == currentStream)
+        if (asyncMode)
         {
-            const uint16 streamId = stream->getStreamId();
+            // Queued once the last stream of the block is known
+            asyncBlocks.push_back({ streamId, numChannels, numSamples, firstSample });
+        }
+        else if (windowSize > 0)
+        {
+            auto history = windowBuffers.find(streamId);
 
-            const int numSamples = getNumSamplesInBlock(streamId);
-            const int numChannels = stream->getChannelCount();
+            if (history == windowBuffers.end())
+                continue;
 
-            // Only for blocks bigger than 0
-            // py::gil_scoped_acquire acquire;
-            if (numSamples > 0) 
-            {
-                py::array_t<float> numpyArray = py::array_t<float>({ numChannels, numSamples });
+            history->second.beginWrite(numSamples, firstSample);
 
-                // Read into numpy array
-                for (int i = 0; i < numChannels; ++i) {
-                    int globalChannelIndex = getGlobalChannelIndex(stream->getStreamId(), i);
+            for (int i = 0; i < numChannels; ++i)
+                history->second.writeChannel(i, getBlockReadPointer(buffer, streamId, i));
 
-                    const float* bufferChannelPtr = buffer.getReadPointer(globalChannelIndex);
-                    float* numpyChannelPtr = numpyArray.mutable_data(i, 0);
-                    memcpy(numpyChannelPtr, bufferChannelPtr, sizeof(float) * numSamples);
-                }
+            history->second.finishWrite();
+            processWindows(streamId, history->second);
+        }
+        else
+        {
+            streamBlocks.push_back(prepareBlock(buffer, streamId, numChannels, numSamples, firstSample));
+        }
+    }
+
+    if (asyncMode)
+    {
+        for (size_t i = 0; i < asyncBlocks.size(); ++i)
+            queueBlock(buffer, asyncBlocks[i], i == asyncBlocks.size() - 1);
 
-                // Call python script on this block
-                pyObject->attr("process")(numpyArray);
+        asyncBlocks.clear();
+        asyncBlockIndex++;
+    }
 
+    // Each shard gathers its own streams on its own thread. The shards share the GIL,
+    // so their Python code only overlaps where it releases it (numpy, scipy)
+    if (!asyncMode && streamShards.size() > 0)
+    {
+        py::gil_scoped_release release;
 
-                // // Write back from numpy array
-                for (int i = 0; i < numChannels; ++i) {
-                    int globalChannelIndex = getGlobalChannelIndex(stream->getStreamId(), i);
+        // A hung script must not hold up the signal chain, so shards get the block deadline
+        const int timeoutMs = getDeadlineMs();
+        uint64 startedShards = 0;
+        bool missedBlock = false;
 
-                    float* bufferChannelPtr = buffer.getWritePointer(globalChannelIndex);
-                    const float* numpyChannelPtr = numpyArray.data(i, 0);
-                    memcpy(bufferChannelPtr, numpyChannelPtr, sizeof(float) * numSamples);
-                }
+        // stream_workers is at most 64
+        for (int i = 0; i < streamShards.size(); ++i)
+        {
+            if (streamShards[i]->startBlock(buffer))
+            {
+                startedShards |= (uint64) 1 << i;
+            }
+            else
+            {
+                callbackStats.numSkippedBlocks++;
+                missedBlock = true;
+            }
+        }
+
+        for (int i = 0; i < streamShards.size(); ++i)
+        {
+            if ((startedShards & ((uint64) 1 << i)) != 0 && !streamShards[i]->waitForBlock(timeoutMs))
+            {
+                callbackStats.numMissedDeadlines++;
+                missedBlock = true;
             }
-            // py::gil_scoped_release release;
-        
         }
 
+        // The streams of a late or busy shard pass through untouched
+        if (missedBlock)
         {
-            ScopedLock TTLlock(TTLqueueLock);
-            while (!TTLQueue.empty())
+            if (maxMissedBlocks > 0 && ++consecutiveMisses >= maxMissedBlocks)
             {
-                const StringTTL& TTLmsg = TTLQueue.front();
-                triggerTTLEvent(TTLmsg, sampleNum);
-                TTLQueue.pop();
+                LOGE("Python stream shards missed ", consecutiveMisses, " consecutive block deadlines, stopping the script");
+                moduleReady = false;
             }
         }
+        else
+        {
+            consecutiveMisses = 0;
+        }
+    }
+
+    if (!streamBlocks.empty())
+    {
+        callProcess();
+
+        for (auto& block : streamBlocks)
+            finishBlock(buffer, block);
+
+        streamBlocks.clear();
     }
+
+    addOutputEvents();
 }
 
-void PythonProcessor::handleTTLEvent(TTLEventPtr event)
+bool PythonProcessor::canUseNativeKernel() const
+{
+    return !outOfProcess && !multiStream && !asyncMode && streamShards.size() == 0
+        && windowSize == 0 && decimationFactor == 1 && !isDeadlineActive();
+}
+
+void PythonProcessor::processNativeKernel(AudioBuffer<float>& buffer)
 {
-    if (event->getStreamId() == currentStream)
+    // Scripts without event hooks never take the GIL during acquisition
     {
-        // Get ttl info
-        auto chanInfo = event->getChannelInfo();
-        auto channelName = chanInfo->getName();
-        const int sourceNodeId = chanInfo->getSourceNodeId();
-        const int64 sampleNumber = event->getSampleNumber();
-        const uint8 line = event->getLine();
-        const bool state = event->getState();
+        std::optional<py::gil_scoped_acquire> acquire;
+
+        if (callbacks.hasEventHooks())
+            acquire.emplace();
+
+        readBlockEvents();
+
+        if (acquire)
+            flushEventBatches();
+    }
+
+    const int numSamples = getNumSamplesInBlock(currentStream);
+
+    if (numSamples > 0)
+    {
+        const int numInputs = getNumBlockChannels(currentStream);
+        const int numChannels = numInputs + getNumOutputChannels(currentStream);
 
-        // Give to python
-        // py::gil_scoped_acquire acquire;
+        // Only reallocates if the channels changed without a new acquisition
+        if ((int) kernelChannels.size() != numChannels)
+            kernelChannels.resize(numChannels);
 
-        if(py::hasattr(*pyObject, "handle_ttl_event"))
+        // The script's output channels follow the channels it reads
+        for (int i = 0; i < numInputs; ++i)
+            kernelChannels[i] = buffer.getWritePointer(getBlockChannelIndex(currentStream, i));
+
+        for (int i = numInputs; i < numChannels; ++i)
+            kernelChannels[i] = buffer.getWritePointer(getOutputChannelIndex(currentStream, i - numInputs));
+
+        const bool succeeded = blockRunner.callKernel(nativeKernel, kernelChannels.data(), numChannels, numSamples,
+                                                      getFirstSampleNumberForBlock(currentStream),
+                                                      getBlockBudget(currentStream, numSamples));
+
+        if (!succeeded)
         {
-            pyObject->attr("handle_ttl_event")(sourceNodeId, channelName.toRawUTF8(), sampleNumber, line, state);
+            LOGE("The native process kernel of ", moduleName, " returned an error, stopping the script");
+            moduleReady = false;
         }
     }
+
+    addOutputEvents();
 }
 
+void PythonProcessor::registerNativeProcess(py::object function, const std::string& signature)
+{
+    // An instance built by a reload during acquisition registers for itself, not the running one
+    NativeKernel& kernel = loadingPendingModule ? pendingKernel : nativeKernel;
+    py::object& owner = loadingPendingModule ? pendingKernelOwner : nativeKernelOwner;
 
-void PythonProcessor::handleSpike(SpikePtr spike)
+    setNativeKernel(kernel, function, signature);
+
+    // Released once the processing thread can no longer be calling the old function
+    owner = function.is_none() ? py::object() : function;
+
+    if (!loadingPendingModule)
+        LOGC(kernel.isSet() ? "Registered a native process kernel for " : "Unregistered the native process kernel of ", moduleName);
+}
+
+void PythonProcessor::callProcess()
 {
-    if (spike->getStreamId() == currentStream)
+    const StreamBlock& originBlock = getEventOriginBlock(streamBlocks);
+    ScopedEventOrigin origin(this, originBlock.streamId, getFullRateSample(originBlock.streamId, originBlock.firstSample),
+                             getDecimation(originBlock.streamId));
+
+    // Call python script on this block, with all streams in one call in multi-stream mode
+    ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                              getBlockBudget(streamBlocks[0].streamId, streamBlocks[0].numSamples));
+
+    if (multiStream)
     {
-        auto spikeChanInfo = spike->getChannelInfo();
+        py::dict blocks;
 
-        const int sourceNodeId = spikeChanInfo->getSourceNodeId();
-        const String electrodeName = spikeChanInfo->getName();
-        const int numChans = spikeChanInfo->getNumChannels();
-        const int64 sampleNum = spike->getSampleNumber();
-        const uint16 sortedId = spike->getSortedId();
-        const int numSamples = spikeChanInfo->getTotalSamples();
+        for (auto& block : streamBlocks)
+            blocks[py::int_(block.streamId)] = block.data;
+
+        PyCallbacks::call(callbacks.process, blocks);
+    }
+    else if (streamBlocks[0].outputs)
+    {
+        PyCallbacks::call(callbacks.process, streamBlocks[0].data, streamBlocks[0].outputs);
+    }
+    else
+    {
+        PyCallbacks::call(callbacks.process, streamBlocks[0].data);
+    }
+}
 
-        py::array_t<float> spikeData = py::array_t<float>({ numChans, numSamples });
+void PythonProcessor::addOutputEvents()
+{
+    const int64 sampleNum = getFirstSampleNumberForBlock(currentStream);
+    const int numSamples = getNumSamplesInBlock(currentStream);
 
-        for (int i = 0; i < numChans; ++i) 
-        {
-            const float* spikeChanDataPtr = spike->getDataPointer(i);
-            float* numpyChannelPtr = spikeData.mutable_data(i, 0);
-            memcpy(numpyChannelPtr, spikeChanDataPtr, sizeof(float) * numSamples);
-        }
+    OutputEvent outputEvent;
 
-        // py::gil_scoped_acquire acquire;
-        if(py::hasattr(*pyObject, "handle_spike"))
-        {
-            pyObject->attr("handle_spike")
-                (sourceNodeId, electrodeName.toRawUTF8(), numChans, numSamples, sampleNum, sortedId, spikeData);
-        }
+    while (outputEvents.pop(outputEvent))
+    {
+        const int64 eventSample = outputEvent.streamId == 0
+            ? sampleNum + outputEvent.sampleNumber
+            : getCurrentStreamSample(outputEvent.streamId, outputEvent.sampleNumber);
+
+        triggerTTLEvent(outputEvent.line, outputEvent.state, eventSample, sampleNum, numSamples);
     }
 }
 
+int64 PythonProcessor::getCurrentStreamSample(uint16 streamId, int64 sampleNumber)
+{
+    if (streamId == currentStream || !streamExists(streamId))
+        return sampleNumber;
 
-// void PythonProcessor::handleBroadcastMessage(String message)
-// {
+    // Streams have their own clocks, so the event keeps its time from the start of its stream's block
+    const double rateRatio = getDataStream(currentStream)->getSampleRate() / getDataStream(streamId)->getSampleRate();
 
-// }
+    return getFirstSampleNumberForBlock(currentStream)
+        + (int64) std::llround((double) (sampleNumber - getFirstSampleNumberForBlock(streamId)) * rateRatio);
+}
 
-void PythonProcessor::addPythonEvent(int line, bool state)
+void PythonProcessor::processWithDeadline(AudioBuffer<float>& buffer)
 {
-    // LOGC("[PYTHON] Event received!! Line: ", line, " | State: ", state);
+    // Events are queued without the GIL, and reach Python with the next block it runs
+    readBlockEvents();
+
+    // Python is still running a block that missed its deadline, so this one goes on without it
+    if (deadlineWorker->isBusy())
+    {
+        callbackStats.numSkippedBlocks++;
+        handleMissedBlock(buffer);
+        addOutputEvents();
+        return;
+    }
+
+    // The worker is idle, so nothing below races with it
+    deadlineBlocks.clear();
+
+    for (auto stream : getDataStreams())
     {
-        ScopedLock TTLlock(TTLqueueLock);
-        if (CoreServices::getAcquisitionStatus()) 
+        const uint16 streamId = stream->getStreamId();
+
+        if (!multiStream && streamId != currentStream)
+            continue;
+
+        int numSamples = getNumSamplesInBlock(streamId);
+        int64 firstSample = getFirstSampleNumberForBlock(streamId);
+        const int numChannels = getNumBlockChannels(streamId);
+
+        if (numSamples == 0 || !decimateBlock(buffer, streamId, numChannels, numSamples, firstSample))
+            continue;
+
+        if (windowSize > 0)
+        {
+            auto history = windowBuffers.find(streamId);
+
+            if (history == windowBuffers.end())
+                continue;
+
+            history->second.beginWrite(numSamples, firstSample);
+
+            for (int i = 0; i < numChannels; ++i)
+                history->second.writeChannel(i, getBlockReadPointer(buffer, streamId, i));
+
+            history->second.finishWrite();
+        }
+        else
         {
-            TTLQueue.push({ line, state });
+            deadlineBlocks.push_back({ streamId, numChannels, numSamples, firstSample });
         }
     }
-}
 
-void PythonProcessor::triggerTTLEvent(StringTTL TTLmsg, juce::int64 sampleNum)
-{
-    TTLEventPtr event = 
-        TTLEvent::createTTLEvent(localEventChannels[currentStream], 
-                                 sampleNum, 
-                                 TTLmsg.eventLine, 
-                                 TTLmsg.state);
-    addEvent(event, 0);
-    
+    // Offsets of events emitted by Python count from the start of this block
+    eventBlockSample = getFirstSampleNumberForBlock(currentStream);
+
+    // The worker copies the blocks to and from Python itself, so this thread never waits for the GIL
+    deadlineWorker->startBlock(buffer);
+
+    if (deadlineWorker->waitForBlock(getDeadlineMs()))
+    {
+        consecutiveMisses = 0;
+    }
+    else
+    {
+        callbackStats.numMissedDeadlines++;
+        handleMissedBlock(buffer);
+    }
+
+    addOutputEvents();
 }
 
-bool PythonProcessor::startAcquisition() 
+void PythonProcessor::processDeadlineBlock(AudioBuffer<float>& buffer)
 {
-    if (moduleReady)
+    // The processing thread may have moved on to a later block, so the origin was kept for this one
+    ScopedEventOrigin origin(this, currentStream, eventBlockSample, getDecimation(currentStream));
+
+    try
     {
-        // py::gil_scoped_acquire acquire;
+        // Includes the events of blocks skipped while Python was late
+        batchDeadlineEvents();
 
-        if(py::hasattr(*pyObject, "start_acquisition"))
+        if (deadlineWorker->beginBufferAccess())
         {
-            try {
-                pyObject->attr("start_acquisition")();
-            }
-            catch (py::error_already_set& e) {
-                handlePythonException("Python Exception!", "Error when starting acquisition in Python:", e);
-            }
+            for (auto& block : deadlineBlocks)
+                streamBlocks.push_back(prepareBlock(buffer, block.streamId, block.numChannels, block.numSamples, block.firstSample));
+
+            deadlineWorker->endBufferAccess();
         }
-        return true;
+
+        flushEventBatches();
+
+        for (auto& history : windowBuffers)
+            processWindows(history.first, history.second);
+
+        if (!streamBlocks.empty())
+            callProcess();
     }
-    return false;
+    catch (py::error_already_set& e)
+    {
+        // Dialogs can only be opened from the message thread, so stop the module and log
+        LOGE("Python Exception on deadline worker:\n", e.what());
+        moduleReady = false;
+    }
+
+    // A late block has already left the plugin, so only Python saw its result
+    if (!streamBlocks.empty() && deadlineWorker->beginBufferAccess())
+    {
+        for (auto& block : streamBlocks)
+            finishBlock(buffer, block);
+
+        if (deadlinePolicy == REUSE_LAST_OUTPUT)
+            saveLastOutputs(buffer);
+
+        deadlineWorker->endBufferAccess();
+    }
+
+    streamBlocks.clear();
 }
 
-bool PythonProcessor::stopAcquisition()
+void PythonProcessor::batchDeadlineEvents()
 {
-    if (moduleReady)
+    while (QueuedItem* item = deadlineEvents.beginRead())
     {
-        // py::gil_scoped_acquire acquire;
-        if(py::hasattr(*pyObject, "stop_acquisition"))
+        if (item->type == QueuedItem::Type::TTL)
         {
-            try {
-                pyObject->attr("stop_acquisition")();
-            }
-            catch (py::error_already_set& e) {
-                handlePythonException("Python Exception!", "Error when stopping acquisition in Python:", e);
-            }
+            ttlBatch.add(item->sourceNodeId, item->channelIndex, item->sampleNumber, item->line, item->state);
+        }
+        else
+        {
+            float* waveform = spikeBatch.add(item->channelIndex, item->sampleNumber, item->sortedId, item->numChannels, item->numSamples);
+
+            for (int i = 0; i < item->numChannels; ++i)
+                memcpy(waveform + (size_t) i * spikeBatch.getRowStride(), item->data.data() + (size_t) i * item->numSamples,
+                       sizeof(float) * item->numSamples);
         }
+
+        deadlineEvents.finishRead();
     }
-    return true;
 }
 
-void PythonProcessor::startRecording() 
+int PythonProcessor::getDeadlineMs()
 {
-    String recordingDirectory = CoreServices::getRecordingDirectoryName();
+    const float sampleRate = getDataStream(currentStream)->getSampleRate();
+    const double blockMs = sampleRate > 0 ? 1000.0 * getNumSamplesInBlock(currentStream) / sampleRate : 0.0;
+
+    return jmax(1, roundToInt(blockMs * deadlinePercent / 100.0));
+}
 
-    // py::gil_scoped_acquire acquire;
-    if(moduleReady && py::hasattr(*pyObject, "start_recording"))
+void PythonProcessor::handleMissedBlock(AudioBuffer<float>& buffer)
+{
+    if (maxMissedBlocks > 0 && ++consecutiveMisses >= maxMissedBlocks)
     {
-        try {
-            pyObject->attr("start_recording")(recordingDirectory.toRawUTF8());
-        }
-        catch (py::error_already_set& e) {
-            handlePythonException("Python Exception!", "Error when starting recording in Python:", e);
+        LOGE("Python missed ", consecutiveMisses, " consecutive block deadlines, stopping the script");
+        moduleReady = false;
+    }
+
+    // Pass-through leaves the block as it arrived
+    if (deadlinePolicy != REUSE_LAST_OUTPUT)
+        return;
+
+    for (auto& output : lastOutputs)
+    {
+        const int numSamples = getNumSamplesInBlock(output.first);
+        const int lastSamples = output.second.getNumSamples();
+
+        if (lastSamples == 0)
+            continue;
+
+        const int numCopied = jmin(numSamples, lastSamples);
+
+        // The end of the last output, holding its final value if this block is longer
+        for (int i = 0; i < output.second.getNumChannels(); ++i)
+        {
+            float* dest = buffer.getWritePointer(getBlockChannelIndex(output.first, i));
+            const float* src = output.second.getReadPointer(i);
+
+            memcpy(dest, src + lastSamples - numCopied, sizeof(float) * numCopied);
+            FloatVectorOperations::fill(dest + numCopied, src[lastSamples - 1], numSamples - numCopied);
+        }
+    }
+}
+
+void PythonProcessor::saveLastOutputs(AudioBuffer<float>& buffer)
+{
+    // Only blocks written back have an output to reuse
+    if (isReadOnly())
+        return;
+
+    for (auto& block : streamBlocks)
+    {
+        if (decimators.count(block.streamId) > 0)
+            continue;
+
+        AudioBuffer<float>& output = lastOutputs[block.streamId];
+        output.setSize(block.numChannels, block.numSamples, false, false, true);
+
+        for (int i = 0; i < block.numChannels; ++i)
+            output.copyFrom(i, 0, buffer, getBlockChannelIndex(block.streamId, i), 0, block.numSamples);
+    }
+}
+
+void PythonProcessor::processWindows(uint16 streamId, WindowBuffer& history)
+{
+    while (history.isWindowReady())
+    {
+        py::array window = windowArrays.acquire(streamId, history.getNumChannels(), history.getWindowSize());
+        int64 startSample;
+
+        if (sampleConverter.getFormat() == SampleConverter::FLOAT32)
+        {
+            startSample = history.readWindow((float*) window.mutable_data());
+        }
+        else
+        {
+            windowScratch.resize((size_t) window.size());
+            startSample = history.readWindow(windowScratch.data());
+            sampleConverter.toPython(windowScratch.data(), window.mutable_data(), windowScratch.size());
+        }
+
+        // Windows overlap and lag the signal chain, so they are never written back
+        BlockRunner::setReadOnly(window);
+
+        // Event offsets count from the start of the window, which may be several blocks back
+        ScopedEventOrigin origin(this, streamId, getFullRateSample(streamId, startSample), getDecimation(streamId));
+
+        ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                                  getBlockBudget(streamId, history.getHopSize()));
+
+        if (multiStream)
+        {
+            py::dict windows;
+            windows[py::int_(streamId)] = window;
+            PyCallbacks::call(callbacks.process, windows, startSample);
+        }
+        else
+        {
+            PyCallbacks::call(callbacks.process, window, startSample);
+        }
+    }
+}
+
+bool PythonProcessor::decimateBlock(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int& numSamples, int64& firstSample)
+{
+    auto decimator = decimators.find(streamId);
+
+    if (decimator == decimators.end())
+        return true;
+
+    decimator->second.beginBlock(numSamples, firstSample);
+
+    for (int i = 0; i < numChannels; ++i)
+        decimator->second.writeChannel(i, buffer.getReadPointer(getBlockChannelIndex(streamId, i)));
+
+    decimator->second.finishBlock();
+
+    numSamples = decimator->second.getNumOutputSamples();
+    firstSample = decimator->second.getFirstOutputSample();
+
+    return numSamples > 0;
+}
+
+int PythonProcessor::getDecimation(uint16 streamId) const
+{
+    return decimators.count(streamId) > 0 ? decimationFactor : 1;
+}
+
+int64 PythonProcessor::getFullRateSample(uint16 streamId, int64 sampleNumber) const
+{
+    auto decimator = decimators.find(streamId);
+
+    if (decimator == decimators.end())
+        return sampleNumber;
+
+    // The anti-alias filter delays the decimated signal, so events line up with what Python saw
+    return sampleNumber * decimationFactor - decimator->second.getDelay();
+}
+
+const PythonProcessor::StreamBlock& PythonProcessor::getEventOriginBlock(const std::vector<StreamBlock>& blocks) const
+{
+    for (auto& block : blocks)
+    {
+        if (block.streamId == currentStream)
+            return block;
+    }
+
+    return blocks[0];
+}
+
+const float* PythonProcessor::getBlockReadPointer(AudioBuffer<float>& buffer, uint16 streamId, int index)
+{
+    auto decimator = decimators.find(streamId);
+
+    if (decimator != decimators.end())
+        return decimator->second.getOutput(index);
+
+    return buffer.getReadPointer(getBlockChannelIndex(streamId, index));
+}
+
+int64 PythonProcessor::getBlockBudget(uint16 streamId, int numSamples)
+{
+    float sampleRate = getDataStream(streamId)->getSampleRate();
+
+    // Decimated blocks cover more time per sample
+    if (decimators.count(streamId) > 0)
+        sampleRate /= decimationFactor;
+
+    return sampleRate > 0 ? (int64) (1.0e9 * numSamples / sampleRate) : 0;
+}
+
+void PythonProcessor::processInWorkerProcess(AudioBuffer<float>& buffer)
+{
+    // Data passes through untouched while the worker is restarting or finishing a late block
+    if (currentStream == 0 || !workerProcess->tryBeginRequest())
+    {
+        if (workerProcess->takeLateRequestFailure())
+            moduleReady = false;
+
+        return;
+    }
+
+    if (workerProcess->takeLateRequestFailure())
+    {
+        workerProcess->endRequest();
+        moduleReady = false;
+        return;
+    }
+
+    readBlockEvents();
+
+    const int64 sampleNum = getFirstSampleNumberForBlock(currentStream);
+    const int numSamples = getNumSamplesInBlock(currentStream);
+    const int numChannels = getDataStream(currentStream)->getChannelCount();
+
+    // The events of a late block are placed by sample number before the next request replaces them
+    if (workerProcess->takeLateReply())
+    {
+        for (int i = 0; i < workerProcess->getNumOutputEvents(); ++i)
+        {
+            const WorkerProcess::OutputEvent event = workerProcess->getOutputEvent(i);
+            triggerTTLEvent(event.line, event.state != 0, lateWorkerBlockSample + event.sampleOffset, sampleNum, numSamples);
+        }
+    }
+
+    float* blockData = nullptr;
+
+    if (numSamples > 0)
+        blockData = workerProcess->addBlock(currentStream, numChannels, numSamples, sampleNum);
+
+    if (blockData != nullptr)
+    {
+        for (int i = 0; i < numChannels; ++i)
+            memcpy(blockData + (size_t) i * numSamples,
+                   buffer.getReadPointer(getGlobalChannelIndex(currentStream, i)),
+                   sizeof(float) * numSamples);
+    }
+
+    WorkerProcess::RequestResult result;
+
+    {
+        // Includes the events sent with the block, and the round trip to the worker
+        ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                                  getBlockBudget(currentStream, numSamples));
+        result = workerProcess->sendBlockRequest(getDeadlineMs());
+    }
+
+    if (result == WorkerProcess::REQUEST_HANDLED)
+    {
+        consecutiveMisses = 0;
+
+        // The script modified the block in shared memory
+        if (blockData != nullptr && !isReadOnly())
+        {
+            for (int i = 0; i < numChannels; ++i)
+                memcpy(buffer.getWritePointer(getGlobalChannelIndex(currentStream, i)),
+                       blockData + (size_t) i * numSamples,
+                       sizeof(float) * numSamples);
+        }
+
+        for (int i = 0; i < workerProcess->getNumOutputEvents(); ++i)
+        {
+            const WorkerProcess::OutputEvent event = workerProcess->getOutputEvent(i);
+            triggerTTLEvent(event.line, event.state != 0, sampleNum + event.sampleOffset, sampleNum, numSamples);
+        }
+    }
+    else if (result == WorkerProcess::REQUEST_LATE)
+    {
+        lateWorkerBlockSample = sampleNum;
+
+        // The block passes through, and the worker takes no new block until it has replied
+        callbackStats.numMissedDeadlines++;
+        handleMissedBlock(buffer);
+    }
+    else if (workerProcess->isReady())
+    {
+        // The script raised an exception, so stop it as in-process mode does
+        moduleReady = false;
+    }
+
+    workerProcess->endRequest();
+}
+
+PythonProcessor::StreamBlock PythonProcessor::prepareBlock(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int numSamples, int64 firstSample)
+{
+    const bool isDecimated = decimators.count(streamId) > 0;
+    const bool isConverted = sampleConverter.getFormat() != SampleConverter::FLOAT32;
+    // A late script would write into a view after the block has moved on
+    const ptrdiff_t channelStride = zeroCopy && !viewKept && !isDecimated && !isConverted && !isDeadlineActive() && streamShards.size() == 0
+        ? getChannelStride(buffer, streamId, numChannels) : 0;
+
+    // Python edits the AudioBuffer directly
+    if (channelStride > 0)
+    {
+        py::array_t<float> view = getBufferView(buffer, streamId, numChannels, numSamples, channelStride);
+
+        if (isReadOnly())
+            BlockRunner::setReadOnly(view);
+
+        StreamBlock block { streamId, numChannels, numSamples, view, firstSample, true };
+        prepareOutputs(buffer, block);
+        return block;
+    }
+
+    // A pooled array in the selected dtype. Decimated data cannot be written back at full rate
+    py::array numpyArray = blockRunner.readBlock(streamId, numChannels, numSamples, isReadOnly() || isDecimated,
+                                                 [&] (int i) { return getBlockReadPointer(buffer, streamId, i); });
+
+    StreamBlock block { streamId, numChannels, numSamples, numpyArray, firstSample, false };
+    prepareOutputs(buffer, block);
+    return block;
+}
+
+void PythonProcessor::prepareOutputs(AudioBuffer<float>& buffer, StreamBlock& block)
+{
+    const int numOutputs = getNumOutputChannels(block.streamId);
+
+    if (numOutputs == 0)
+        return;
+
+    // The output channels are added together, so they are usually evenly strided
+    float* firstChannelPtr = buffer.getWritePointer(getOutputChannelIndex(block.streamId, 0));
+    ptrdiff_t channelStride = numOutputs > 1
+        ? buffer.getWritePointer(getOutputChannelIndex(block.streamId, 1)) - firstChannelPtr
+        : buffer.getNumSamples();
+
+    for (int i = 2; i < numOutputs; ++i)
+    {
+        if (buffer.getWritePointer(getOutputChannelIndex(block.streamId, i)) != firstChannelPtr + i * channelStride)
+            channelStride = 0;
+    }
+
+    // A late script would write into a view after the block has moved on
+    if (channelStride > 0 && !viewKept && !isDeadlineActive())
+    {
+        py::capsule owner(firstChannelPtr, [](void*) {});
+
+        block.outputs = py::array_t<float>({ (ssize_t) numOutputs, (ssize_t) block.numSamples },
+                                           { (ssize_t) (channelStride * sizeof(float)), (ssize_t) sizeof(float) },
+                                           firstChannelPtr,
+                                           owner);
+        block.outputsAreView = true;
+        return;
+    }
+
+    py::array outputs = outputArrays.acquire(block.streamId, numOutputs, block.numSamples);
+
+    for (int i = 0; i < numOutputs; ++i)
+        memset(outputs.mutable_data(i, 0), 0, sizeof(float) * block.numSamples);
+
+    block.outputs = outputs;
+}
+
+void PythonProcessor::finishBlock(AudioBuffer<float>& buffer, StreamBlock& block)
+{
+    // Output channels are written whether or not the input is read-only
+    if (block.outputs && block.outputsAreView)
+    {
+        BlockRunner::setReadOnly(block.outputs);
+        checkViewKept(block.outputs);
+    }
+    else if (block.outputs)
+    {
+        py::array outputs = py::reinterpret_borrow<py::array>(block.outputs);
+
+        for (int i = 0; i < outputs.shape(0); ++i)
+            memcpy(buffer.getWritePointer(getOutputChannelIndex(block.streamId, i)),
+                   outputs.data(i, 0),
+                   sizeof(float) * block.numSamples);
+    }
+
+    if (block.isView)
+    {
+        // Any reference kept by the script must not write into later blocks
+        BlockRunner::setReadOnly(block.data);
+        checkViewKept(block.data);
+        return;
+    }
+
+    // The script could not have changed the block
+    if (isReadOnly() || decimators.count(block.streamId) > 0)
+        return;
+
+    // Write back from numpy array
+    blockRunner.writeBlock(block.data, block.numChannels, block.numSamples,
+                           [&] (int i) { return buffer.getWritePointer(getBlockChannelIndex(block.streamId, i)); });
+}
+
+void PythonProcessor::checkViewKept(const py::object& view)
+{
+    // Only the block holds the view once process() has returned, unless the script kept it
+    if (viewKept || view.ref_count() <= 1)
+        return;
+
+    viewKept = true;
+    LOGE(moduleName, " kept an array that views the signal chain's buffer. It will show later blocks, or freed memory "
+         "once the buffer is reallocated. Passing copies for the rest of the acquisition; copy anything you keep");
+}
+
+void PythonProcessor::processShard(StreamShard& shard, AudioBuffer<float>& buffer)
+{
+    if (!moduleReady || shard.pyObject == nullptr)
+        return;
+
+    std::vector<StreamBlock> shardBlocks;
+    shardBlocks.reserve(shard.streamIds.size());
+
+    // The processing thread may have given up on this block while the shard waited for the GIL
+    if (!shard.beginBufferAccess())
+        return;
+
+    for (auto streamId : shard.streamIds)
+    {
+        int numSamples = getNumSamplesInBlock(streamId);
+        int64 firstSample = getFirstSampleNumberForBlock(streamId);
+        const int numChannels = getNumBlockChannels(streamId);
+
+        if (numSamples > 0 && decimateBlock(buffer, streamId, numChannels, numSamples, firstSample))
+            shardBlocks.push_back(prepareBlock(buffer, streamId, numChannels, numSamples, firstSample));
+    }
+
+    shard.endBufferAccess();
+
+    if (shardBlocks.empty())
+        return;
+
+    try
+    {
+        py::dict blocks;
+
+        for (auto& block : shardBlocks)
+            blocks[py::int_(block.streamId)] = block.data;
+
+        const StreamBlock& originBlock = getEventOriginBlock(shardBlocks);
+        ScopedEventOrigin origin(this, originBlock.streamId, getFullRateSample(originBlock.streamId, originBlock.firstSample),
+                                 getDecimation(originBlock.streamId));
+
+        ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                                  getBlockBudget(shardBlocks[0].streamId, shardBlocks[0].numSamples));
+        PyCallbacks::call(shard.callbacks.process, blocks);
+    }
+    catch (py::error_already_set& e)
+    {
+        // Dialogs can only be opened from the message thread, so stop the module and log
+        LOGE("Python Exception on ", shard.getThreadName(), ":\n", e.what());
+        moduleReady = false;
+    }
+
+    // A late block has already left the plugin, so only Python saw its result
+    if (!shard.beginBufferAccess())
+        return;
+
+    for (auto& block : shardBlocks)
+        finishBlock(buffer, block);
+
+    shard.endBufferAccess();
+}
+
+void PythonProcessor::prepareArrayPools()
+{
+    blockArrays.reset(sampleConverter.getDtypeName());
+    windowArrays.reset(sampleConverter.getDtypeName());
+    spikeArrays.reset("float32");
+    outputArrays.reset("float32");
+
+    if (outputStream > 0)
+        outputArrays.prepare(outputStream, getNumOutputChannels(outputStream), initialBlockSamples);
+
+    for (auto stream : getDataStreams())
+    {
+        const uint16 streamId = stream->getStreamId();
+
+        if (!multiStream && streamId != currentStream)
+            continue;
+
+        const int numChannels = getNumBlockChannels(streamId);
+
+        if (windowSize > 0)
+            windowArrays.prepare(streamId, numChannels, windowSize);
+        else
+            blockArrays.prepare(streamId, numChannels, (initialBlockSamples + decimationFactor - 1) / decimationFactor);
+    }
+
+    for (auto& electrode : electrodeIndices)
+        spikeArrays.prepare(electrode.second, electrode.first->getNumChannels(), electrode.first->getTotalSamples());
+}
+
+void PythonProcessor::clearStreamShards()
+{
+    for (auto shard : streamShards)
+    {
+        shard->callbacks.clear();
+        delete shard->pyObject;
+    }
+
+    streamShards.clear();
+}
+
+std::vector<PyCallbacks*> PythonProcessor::getAllCallbacks()
+{
+    std::vector<PyCallbacks*> all;
+
+    if (streamShards.size() == 0)
+    {
+        if (pyObject != nullptr)
+            all.push_back(&callbacks);
+    }
+    else
+    {
+        for (auto shard : streamShards)
+        {
+            if (shard->pyObject != nullptr)
+                all.push_back(&shard->callbacks);
+        }
+    }
+
+    return all;
+}
+
+PyCallbacks* PythonProcessor::getStreamCallbacks(uint16 streamId)
+{
+    if (streamShards.size() == 0)
+        return pyObject != nullptr ? &callbacks : nullptr;
+
+    for (auto shard : streamShards)
+    {
+        if (shard->streamIds.contains(streamId))
+            return shard->pyObject != nullptr ? &shard->callbacks : nullptr;
+    }
+
+    return nullptr;
+}
+
+TTLBatch* PythonProcessor::getStreamTTLBatch(uint16 streamId)
+{
+    if (streamShards.size() == 0)
+        return &ttlBatch;
+
+    for (auto shard : streamShards)
+    {
+        if (shard->streamIds.contains(streamId))
+            return &shard->ttlBatch;
+    }
+
+    return nullptr;
+}
+
+SpikeBatch* PythonProcessor::getStreamSpikeBatch(uint16 streamId)
+{
+    if (streamShards.size() == 0)
+        return &spikeBatch;
+
+    for (auto shard : streamShards)
+    {
+        if (shard->streamIds.contains(streamId))
+            return &shard->spikeBatch;
+    }
+
+    return nullptr;
+}
+
+void PythonProcessor::flushEventBatches()
+{
+    // Scripts with only the per-event hooks have batches in deadline mode,
+    // so the hooks run on the deadline worker
+    if (streamShards.size() == 0)
+    {
+        blockRunner.flushEvents(callbacks, ttlBatch, spikeBatch, eventChannelTable, electrodeTable);
+        return;
+    }
+
+    for (auto shard : streamShards)
+        blockRunner.flushEvents(shard->callbacks, shard->ttlBatch, shard->spikeBatch, eventChannelTable, electrodeTable);
+}
+
+void PythonProcessor::updateChannelTables()
+{
+    electrodeIndices.clear();
+    eventChannelIndices.clear();
+
+    py::list electrodes;
+
+    for (int i = 0; i < spikeChannels.size(); ++i)
+    {
+        const SpikeChannel* chan = spikeChannels[i];
+        electrodeIndices[chan] = i;
+
+        electrodes.append(py::make_tuple(chan->getSourceNodeId(), chan->getName().toStdString(),
+                                         chan->getNumChannels(), chan->getTotalSamples()));
+    }
+
+    py::list channels;
+
+    for (auto chan : eventChannels)
+    {
+        if (chan->getType() != EventChannel::Type::TTL)
+            continue;
+
+        eventChannelIndices[chan] = (int) channels.size();
+        channels.append(py::make_tuple(chan->getSourceNodeId(), chan->getName().toStdString()));
+    }
+
+    electrodeTable = py::tuple(electrodes);
+    eventChannelTable = py::tuple(channels);
+}
+
+int PythonProcessor::getNumBlockChannels(uint16 streamId)
+{
+    if (streamId == currentStream && !selectedChannels.isEmpty())
+        return selectedChannels.size();
+
+    return getNumInputChannels(streamId);
+}
+
+int PythonProcessor::getNumInputChannels(uint16 streamId)
+{
+    return getDataStream(streamId)->getChannelCount() - getNumOutputChannels(streamId);
+}
+
+int PythonProcessor::getOutputChannelIndex(uint16 streamId, int index)
+{
+    return getGlobalChannelIndex(streamId, getNumInputChannels(streamId) + index);
+}
+
+bool PythonProcessor::supportsOutputChannels() const
+{
+    return !outOfProcess && !multiStream && !asyncMode && windowSize == 0 && decimationFactor == 1;
+}
+
+StringArray PythonProcessor::getScriptOutputChannels()
+{
+    StringArray names;
+
+    if (pyModule == nullptr || !supportsOutputChannels() || !streamExists(currentStream))
+        return names;
+
+    py::gil_scoped_acquire acquire;
+
+    try
+    {
+        py::object declared = py::getattr(pyModule->attr("PyProcessor"), "output_channels", py::none());
+
+        if (py::isinstance<py::int_>(declared))
+        {
+            for (int i = 0; i < declared.cast<int>(); ++i)
+                names.add("PY" + String(i + 1));
+        }
+        else if (!declared.is_none())
+        {
+            for (auto name : declared)
+                names.add(String(py::str(name).cast<std::string>()));
+        }
+    }
+    catch (std::exception& e)
+    {
+        LOGE("output_channels must be a number of channels or a list of names: ", e.what());
+        names.clear();
+    }
+
+    return names;
+}
+
+void PythonProcessor::updateOutputChannels()
+{
+    std::weak_ptr<bool> alive = aliveToken;
+
+    // Channels are only added by updateSettings(), so the signal chain is updated once the
+    // current update (if any) has finished
+    MessageManager::callAsync([this, alive]
+    {
+        if (alive.lock() == nullptr || editorPtr == nullptr || CoreServices::getAcquisitionStatus())
+            return;
+
+        const StringArray declared = getScriptOutputChannels();
+
+        if (declared != outputChannelNames || (declared.size() > 0 && outputStream != currentStream))
+            CoreServices::updateSignalChain(editorPtr);
+    });
+}
+
+void PythonProcessor::clearOutputChannels(AudioBuffer<float>& buffer)
+{
+    const int numSamples = getNumSamplesInBlock(outputStream);
+
+    for (int i = 0; i < getNumOutputChannels(outputStream); ++i)
+        buffer.clear(getOutputChannelIndex(outputStream, i), 0, numSamples);
+}
+
+int PythonProcessor::getBlockChannelIndex(uint16 streamId, int index)
+{
+    // Unselected channels are never copied and pass through untouched
+    if (streamId == currentStream && !selectedChannels.isEmpty())
+        index = selectedChannels[index];
+
+    return getGlobalChannelIndex(streamId, index);
+}
+
+void PythonProcessor::updateSelectedChannels(int numChans)
+{
+    selectedChannels.clear();
+
+    if (selectedChannelsText.isNotEmpty())
+    {
+        // Editor entry such as "1-4, 9", counting from 1
+        for (auto token : StringArray::fromTokens(selectedChannelsText, ",", ""))
+        {
+            token = token.trim();
+
+            if (token.isEmpty())
+                continue;
+
+            const int first = token.upToFirstOccurrenceOf("-", false, false).getIntValue();
+            const int last = token.contains("-") ? token.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+
+            for (int chan = jmax(first, 1); chan <= jmin(last, numChans); ++chan)
+                selectedChannels.addIfNotAlreadyThere(chan - 1);
+        }
+
+        if (selectedChannels.isEmpty())
+            LOGE("No valid channels in \"", selectedChannelsText, "\", passing all channels to Python");
+    }
+    else if (py::hasattr(*pyObject, "selected_channels") && !pyObject->attr("selected_channels").is_none())
+    {
+        // Declared by the script in __init__, counting from 0
+        try
+        {
+            for (int chan : pyObject->attr("selected_channels").cast<std::vector<int>>())
+            {
+                if (chan >= 0 && chan < numChans)
+                    selectedChannels.addIfNotAlreadyThere(chan);
+            }
+        }
+        catch (py::cast_error&)
+        {
+            LOGE("selected_channels must be a list of channel indices, passing all channels to Python");
+            selectedChannels.clear();
+        }
+    }
+
+    selectedChannels.sort();
+
+    // Selecting every channel is the same as no selection
+    if (selectedChannels.size() == numChans)
+        selectedChannels.clear();
+
+    if (!selectedChannels.isEmpty())
+        LOGC("Passing ", selectedChannels.size(), " of ", numChans, " channels to Python");
+}
+
+ptrdiff_t PythonProcessor::getChannelStride(AudioBuffer<float>& buffer, uint16 streamId, int numChannels)
+{
+    if (numChannels == 0)
+        return 0;
+
+    const float* firstChannelPtr = buffer.getReadPointer(getBlockChannelIndex(streamId, 0));
+
+    if (numChannels == 1)
+        return buffer.getNumSamples();
+
+    const ptrdiff_t channelStride = buffer.getReadPointer(getBlockChannelIndex(streamId, 1)) - firstChannelPtr;
+
+    // Channels must be laid out at a constant distance for numpy strides to describe them
+    for (int i = 2; i < numChannels; ++i)
+    {
+        if (buffer.getReadPointer(getBlockChannelIndex(streamId, i)) != firstChannelPtr + i * channelStride)
+            return 0;
+    }
+
+    return channelStride;
+}
+
+py::array_t<float> PythonProcessor::getBufferView(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int numSamples, ptrdiff_t channelStride)
+{
+    float* firstChannelPtr = buffer.getWritePointer(getBlockChannelIndex(streamId, 0));
+
+    // The buffer is owned by the signal chain, so the capsule must not free it
+    py::capsule owner(firstChannelPtr, [](void*) {});
+
+    return py::array_t<float>({ (ssize_t) numChannels, (ssize_t) numSamples },
+                              { (ssize_t) (channelStride * sizeof(float)), (ssize_t) sizeof(float) },
+                              firstChannelPtr,
+                              owner);
+}
+
+void PythonProcessor::queueBlock(AudioBuffer<float>& buffer, const AsyncBlock& block, bool lastInBlock)
+{
+    // Blocks longer than the slots were sized for are dropped and counted
+    QueuedItem* item = blockQueue.beginWrite((size_t) block.numChannels * block.numSamples);
+
+    if (item == nullptr)
+        return;
+
+    item->type = QueuedItem::Type::BLOCK;
+    item->streamId = block.streamId;
+    item->sampleNumber = block.firstSample;
+    item->blockSampleNumber = getFirstSampleNumberForBlock(block.streamId);
+    item->blockIndex = asyncBlockIndex;
+    item->lastInBlock = lastInBlock;
+    item->numChannels = block.numChannels;
+    item->numSamples = block.numSamples;
+
+    for (int i = 0; i < block.numChannels; ++i)
+    {
+        const float* bufferChannelPtr = getBlockReadPointer(buffer, block.streamId, i);
+        memcpy(item->data.data() + (size_t) i * block.numSamples, bufferChannelPtr, sizeof(float) * block.numSamples);
+    }
+
+    blockQueue.finishWrite();
+    asyncWorker->notify();
+}
+
+void PythonProcessor::handleQueuedItem(QueuedItem& item)
+{
+    // Queued items are a block boundary for a module reloaded during acquisition
+    applyPendingModule();
+
+    if (!moduleReady || pyObject == nullptr)
+        return;
+
+    try
+    {
+        // The streams of a block are gathered into one process() call, as in sync mode.
+        // Anything else comes after them
+        if (multiStream && item.type == QueuedItem::Type::BLOCK && windowSize == 0)
+        {
+            queueStreamBlock(item);
+            return;
+        }
+
+        flushQueuedBlocks();
+
+        // Python runs behind the signal chain, so event offsets count from the block the item came from
+        ScopedEventOrigin origin(this, item.streamId,
+                                 item.type == QueuedItem::Type::BLOCK ? getFullRateSample(item.streamId, item.sampleNumber)
+                                                                      : item.blockSampleNumber,
+                                 getDecimation(item.streamId));
+
+        if (item.type == QueuedItem::Type::TTL)
+        {
+            callTTLEventHook(callbacks, item.sourceNodeId, item.channelName, item.sampleNumber, item.line, item.state);
+            return;
+        }
+
+        if (item.type == QueuedItem::Type::BLOCK && windowSize > 0)
+        {
+            auto history = windowBuffers.find(item.streamId);
+
+            if (history != windowBuffers.end())
+            {
+                history->second.beginWrite(item.numSamples, item.sampleNumber);
+
+                for (int i = 0; i < item.numChannels; ++i)
+                    history->second.writeChannel(i, item.data.data() + (size_t) i * item.numSamples);
+
+                history->second.finishWrite();
+                processWindows(item.streamId, history->second);
+            }
+
+            return;
+        }
+
+        // The slot is recycled once this returns, so Python gets a pooled copy. The pool
+        // allocates a new array if the script kept the last one
+        if (item.type == QueuedItem::Type::BLOCK)
+        {
+            py::array blockArray = blockArrays.acquire(item.streamId, item.numChannels, item.numSamples);
+
+            for (int i = 0; i < item.numChannels; ++i)
+                sampleConverter.toPython(item.data.data() + (size_t) i * item.numSamples, blockArray.mutable_data(i, 0), item.numSamples);
+
+            // The block has left the plugin by now, so writes would be lost: raise instead
+            BlockRunner::setReadOnly(blockArray);
+
+            ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                                      getBlockBudget(item.streamId, item.numSamples));
+            PyCallbacks::call(callbacks.process, blockArray);
+        }
+        else
+        {
+            py::array spikeData = spikeArrays.acquire(item.channelIndex, item.numChannels, item.numSamples);
+
+            for (int i = 0; i < item.numChannels; ++i)
+                memcpy(spikeData.mutable_data(i, 0), item.data.data() + (size_t) i * item.numSamples, sizeof(float) * item.numSamples);
+
+            callSpikeHook(callbacks, item.sourceNodeId, item.channelName, item.numChannels, item.numSamples,
+                          item.sampleNumber, item.sortedId, spikeData);
+        }
+    }
+    catch (py::error_already_set& e)
+    {
+        // Dialogs can only be opened from the message thread, so stop the module and log
+        LOGE("Python Exception on worker thread:\n", e.what());
+        moduleReady = false;
+    }
+}
+
+void PythonProcessor::queueStreamBlock(QueuedItem& item)
+{
+    // The last stream of the previous block was dropped
+    if (queuedBlocks && item.blockIndex != queuedBlockIndex)
+        flushQueuedBlocks();
+
+    if (!queuedBlocks)
+        queuedBlocks = py::dict();
+
+    // The slot is recycled before the other streams arrive, so the block is copied
+    py::array blockArray = blockArrays.acquire(item.streamId, item.numChannels, item.numSamples);
+
+    for (int i = 0; i < item.numChannels; ++i)
+        sampleConverter.toPython(item.data.data() + (size_t) i * item.numSamples, blockArray.mutable_data(i, 0), item.numSamples);
+
+    BlockRunner::setReadOnly(blockArray);
+
+    // Event offsets count samples of the current stream, if the block has it
+    if (py::len(queuedBlocks) == 0 || item.streamId == currentStream)
+    {
+        queuedBlockSamples = item.numSamples;
+        queuedBlockStream = item.streamId;
+        queuedBlockFirstSample = item.sampleNumber;
+    }
+
+    queuedBlocks[py::int_(item.streamId)] = blockArray;
+    queuedBlockIndex = item.blockIndex;
+
+    if (item.lastInBlock)
+        flushQueuedBlocks();
+}
+
+void PythonProcessor::flushQueuedBlocks()
+{
+    if (!queuedBlocks)
+        return;
+
+    // Released before the call, so a script that raises does not leave a stale batch
+    py::object blocks = std::move(queuedBlocks);
+
+    ScopedEventOrigin origin(this, queuedBlockStream, getFullRateSample(queuedBlockStream, queuedBlockFirstSample),
+                             getDecimation(queuedBlockStream));
+
+    ScopedCallbackTimer timer(callbackStats.process, &callbackStats.numOverruns,
+                              getBlockBudget(queuedBlockStream, queuedBlockSamples));
+    PyCallbacks::call(callbacks.process, blocks);
+}
+
+void PythonProcessor::handleTTLEvent(TTLEventPtr event)
+{
+    if (streamExporter.isOpen() && event->getStreamId() == exportStream)
+        streamExporter.addTTLEvent(event->getChannelInfo()->getSourceNodeId(), event->getChannelInfo()->getName().toRawUTF8(),
+                                   event->getSampleNumber(), event->getLine(), event->getState());
+
+    if (!moduleReady || exportEventsOnly)
+        return;
+
+    if (multiStream || event->getStreamId() == currentStream)
+    {
+        // Get ttl info
+        auto chanInfo = event->getChannelInfo();
+        auto channelName = chanInfo->getName();
+        const int sourceNodeId = chanInfo->getSourceNodeId();
+        const int64 sampleNumber = event->getSampleNumber();
+        const uint8 line = event->getLine();
+        const bool state = event->getState();
+
+        if (outOfProcess)
+        {
+            workerProcess->addTTLEvent(sourceNodeId, channelName.toRawUTF8(), sampleNumber, line, state);
+        }
+        else if (asyncMode)
+        {
+            QueuedItem* item = blockQueue.beginWrite(0);
+
+            if (item != nullptr)
+            {
+                item->type = QueuedItem::Type::TTL;
+                item->streamId = event->getStreamId();
+                item->sampleNumber = sampleNumber;
+                item->blockSampleNumber = getFirstSampleNumberForBlock(event->getStreamId());
+                item->numChannels = 0;
+                item->numSamples = 0;
+                item->sourceNodeId = sourceNodeId;
+                channelName.copyToUTF8(item->channelName, sizeof(item->channelName));
+                item->line = line;
+                item->state = state;
+
+                blockQueue.finishWrite();
+            }
+        }
+        else if (PyCallbacks* target = getStreamCallbacks(event->getStreamId()))
+        {
+            auto channel = eventChannelIndices.find(chanInfo);
+            const int channelIndex = channel != eventChannelIndices.end() ? channel->second : -1;
+
+            if (isDeadlineActive())
+            {
+                // Batched by the deadline worker for the next block Python runs, so this thread needs no GIL
+                QueuedItem* item = (target->handleTTLEvents || target->handleTTLEvent) ? deadlineEvents.beginWrite(0) : nullptr;
+
+                if (item != nullptr)
+                {
+                    item->type = QueuedItem::Type::TTL;
+                    item->streamId = event->getStreamId();
+                    item->sampleNumber = sampleNumber;
+                    item->numChannels = 0;
+                    item->numSamples = 0;
+                    item->sourceNodeId = sourceNodeId;
+                    item->channelIndex = channelIndex;
+                    item->line = line;
+                    item->state = state;
+
+                    deadlineEvents.finishWrite();
+                }
+            }
+            else if (target->handleTTLEvents)
+            {
+                // Collected and passed to handle_ttl_events() once the block's events have been read
+                getStreamTTLBatch(event->getStreamId())->add(sourceNodeId, channelIndex, sampleNumber, line, state);
+            }
+            else
+            {
+                // Give to python
+                callTTLEventHook(*target, sourceNodeId, channelName.toRawUTF8(), sampleNumber, line, state);
+            }
+        }
+    }
+}
+
+void PythonProcessor::callTTLEventHook(PyCallbacks& target, int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state)
+{
+    if (target.handleTTLEvent)
+    {
+        ScopedCallbackTimer timer(callbackStats.handleTTLEvent);
+        PyCallbacks::call(target.handleTTLEvent, sourceNodeId, channelName, sampleNumber, line, state);
+    }
+}
+
+
+void PythonProcessor::handleSpike(SpikePtr spike)
+{
+    if (streamExporter.isOpen() && spike->getStreamId() == exportStream)
+        streamExporter.addSpike(spike->getChannelInfo()->getSourceNodeId(), spike->getChannelInfo()->getName().toRawUTF8(),
+                                spike->getSampleNumber(), spike->getSortedId(), spike->getChannelInfo()->getNumChannels());
+
+    if (!moduleReady || exportEventsOnly)
+        return;
+
+    if (multiStream || spike->getStreamId() == currentStream)
+    {
+        auto spikeChanInfo = spike->getChannelInfo();
+
+        const int sourceNodeId = spikeChanInfo->getSourceNodeId();
+        const String electrodeName = spikeChanInfo->getName();
+        const int numChans = spikeChanInfo->getNumChannels();
+        const int64 sampleNum = spike->getSampleNumber();
+        const uint16 sortedId = spike->getSortedId();
+        const int numSamples = spikeChanInfo->getTotalSamples();
+
+        if (outOfProcess)
+        {
+            float* spikeData = workerProcess->addSpike(sourceNodeId, electrodeName.toRawUTF8(), numChans, numSamples, sampleNum, sortedId);
+
+            if (spikeData != nullptr)
+            {
+                for (int i = 0; i < numChans; ++i)
+                    memcpy(spikeData + (size_t) i * numSamples, spike->getDataPointer(i), sizeof(float) * numSamples);
+            }
+
+            return;
+        }
+
+        // Selects the electrode's pooled array on the Python side
+        auto electrode = electrodeIndices.find(spikeChanInfo);
+        const int electrodeIndex = electrode != electrodeIndices.end() ? electrode->second : -1;
+
+        if (asyncMode)
+        {
+            QueuedItem* item = blockQueue.beginWrite((size_t) numChans * numSamples);
+
+            if (item != nullptr)
+            {
+                item->type = QueuedItem::Type::SPIKE;
+                item->streamId = spike->getStreamId();
+                item->sampleNumber = sampleNum;
+                item->blockSampleNumber = getFirstSampleNumberForBlock(spike->getStreamId());
+                item->numChannels = numChans;
+                item->numSamples = numSamples;
+                item->sourceNodeId = sourceNodeId;
+                electrodeName.copyToUTF8(item->channelName, sizeof(item->channelName));
+                item->channelIndex = electrodeIndex;
+                item->sortedId = sortedId;
+
+                for (int i = 0; i < numChans; ++i)
+                    memcpy(item->data.data() + (size_t) i * numSamples, spike->getDataPointer(i), sizeof(float) * numSamples);
+
+                blockQueue.finishWrite();
+            }
+
+            return;
+        }
+
+        PyCallbacks* target = getStreamCallbacks(spike->getStreamId());
+
+        if (target == nullptr)
+            return;
+
+        if (isDeadlineActive())
+        {
+            // Batched by the deadline worker for the next block Python runs, so this thread needs no GIL
+            QueuedItem* item = (target->handleSpikes || target->handleSpike)
+                ? deadlineEvents.beginWrite((size_t) numChans * numSamples) : nullptr;
+
+            if (item != nullptr)
+            {
+                item->type = QueuedItem::Type::SPIKE;
+                item->streamId = spike->getStreamId();
+                item->sampleNumber = sampleNum;
+                item->numChannels = numChans;
+                item->numSamples = numSamples;
+                item->sourceNodeId = sourceNodeId;
+                item->channelIndex = electrodeIndex;
+                item->sortedId = sortedId;
+
+                for (int i = 0; i < numChans; ++i)
+                    memcpy(item->data.data() + (size_t) i * numSamples, spike->getDataPointer(i), sizeof(float) * numSamples);
+
+                deadlineEvents.finishWrite();
+            }
+
+            return;
+        }
+
+        // Collected and passed to handle_spikes() once the block's events have been read
+        if (target->handleSpikes)
+        {
+            SpikeBatch* batch = getStreamSpikeBatch(spike->getStreamId());
+
+            float* waveform = batch->add(electrodeIndex, sampleNum, sortedId, numChans, numSamples);
+
+            for (int i = 0; i < numChans; ++i)
+                memcpy(waveform + (size_t) i * batch->getRowStride(), spike->getDataPointer(i), sizeof(float) * numSamples);
+
+            return;
+        }
+
+        if (!target->handleSpike)
+            return;
+
+        // Reused for every spike of this electrode
+        py::array spikeData = spikeArrays.acquire(electrodeIndex, numChans, numSamples);
+
+        for (int i = 0; i < numChans; ++i) 
+        {
+            const float* spikeChanDataPtr = spike->getDataPointer(i);
+            void* numpyChannelPtr = spikeData.mutable_data(i, 0);
+            memcpy(numpyChannelPtr, spikeChanDataPtr, sizeof(float) * numSamples);
+        }
+
+        callSpikeHook(*target, sourceNodeId, electrodeName.toRawUTF8(), numChans, numSamples, sampleNum, sortedId, spikeData);
+    }
+}
+
+void PythonProcessor::callSpikeHook(PyCallbacks& target, int sourceNodeId, const char* electrodeName, int numChans, int numSamples,
+                                    int64 sampleNum, uint16 sortedId, py::array& spikeData)
+{
+    if (target.handleSpike)
+    {
+        ScopedCallbackTimer timer(callbackStats.handleSpike);
+        PyCallbacks::call(target.handleSpike,
+                          sourceNodeId, electrodeName, numChans, numSamples, sampleNum, sortedId, spikeData);
+    }
+}
+
+
+// void PythonProcessor::handleBroadcastMessage(String message)
+// {
+
+// }
+
+void PythonProcessor::addPythonEvent(int line, bool state, int sampleOffset)
+{
+    if (CoreServices::getAcquisitionStatus())
+        outputEvents.push(makeOutputEvent(this, line, state, sampleOffset));
+}
+
+void PythonProcessor::addPythonEvents(py::array_t<int, py::array::c_style | py::array::forcecast> lines,
+                                      py::array_t<bool, py::array::c_style | py::array::forcecast> states,
+                                      py::object sampleOffsets)
+{
+    const ssize_t numEvents = lines.size();
+
+    if (states.size() != numEvents)
+        throw py::value_error("lines and states must have the same length");
+
+    auto offsets = py::array_t<int, py::array::c_style | py::array::forcecast>::ensure(sampleOffsets);
+    const int* offsetData = nullptr;
+
+    if (!sampleOffsets.is_none())
+    {
+        if (!offsets || offsets.size() != numEvents)
+            throw py::value_error("sample_offsets must be integers, with one per event");
+
+        offsetData = offsets.data();
+    }
+
+    if (!CoreServices::getAcquisitionStatus())
+        return;
+
+    const int* lineData = lines.data();
+    const bool* stateData = states.data();
+
+    for (ssize_t i = 0; i < numEvents; ++i)
+        outputEvents.push(makeOutputEvent(this, lineData[i], stateData[i], offsetData != nullptr ? offsetData[i] : 0));
+}
+
+void PythonProcessor::triggerTTLEvent(uint8 line, bool state, juce::int64 eventSample, juce::int64 sampleNum, int numSamples)
+{
+    int sampleOffset = 0;
+
+    if (eventSample < sampleNum)
+    {
+        // The block Python saw has already left the plugin, so the event keeps its sample number
+        callbackStats.numLateEvents++;
+    }
+    else
+    {
+        // Events past the end of the block are added at its last sample
+        sampleOffset = (int) jmin(eventSample - sampleNum, (int64) jmax(numSamples - 1, 0));
+        eventSample = sampleNum + sampleOffset;
+    }
+
+    TTLEventPtr event = 
+        TTLEvent::createTTLEvent(localEventChannels[currentStream], 
+                                 eventSample, 
+                                 line, 
+                                 state);
+    addEvent(event, sampleOffset);
+
+    if (streamExporter.isOpen() && exportStream == currentStream)
+        streamExporter.addTTLEvent(getNodeId(), localEventChannels[currentStream]->getName().toRawUTF8(),
+                                   eventSample, line, state);
+    
+}
+
+bool PythonProcessor::startAcquisition() 
+{
+    // A warm-up still loading gets a bounded wait. Past that, acquisition starts without
+    // the new script, which is imported once acquisition stops
+    if (warmupActive && !warmupThread->waitForThreadToExit(maxWarmupWaitMs))
+    {
+        LOGC("Python modules are still loading, the script will be loaded when acquisition stops");
+
+        if (editorPtr != nullptr)
+            editorPtr->setStatusText("Still loading Python modules...");
+    }
+    else
+    {
+        finishWarmup();
+    }
+
+    acquiring = true;
+
+    callbackStats.reset();
+    outputEvents.resetNumDropped();
+
+    // Windows and filter state start afresh with every acquisition
+    windowBuffers.clear();
+    decimators.clear();
+    lastOutputs.clear();
+    consecutiveMisses = 0;
+    viewKept = false;
+
+    if (exportEnabled && streamExists(currentStream))
+    {
+        // Includes the output channels added for the script
+        StringArray channelNames;
+
+        for (auto channel : getDataStream(currentStream)->getContinuousChannels())
+            channelNames.add(channel->getName());
+
+        const double sampleRate = getDataStream(currentStream)->getSampleRate();
+        const int ringSamples = (int) jmin(sampleRate * (int) getParameter("export_seconds")->getValue(), 1.0e9);
+
+        if (streamExporter.open(getParameter("export_name")->getValueAsString(), currentStream, channelNames, sampleRate, ringSamples))
+            exportStream = currentStream;
+
+        streamExporter.setAcquisitionActive(true);
+    }
+    else
+    {
+        streamExporter.close();
+    }
+
+    if (!outOfProcess)
+    {
+        for (auto stream : getDataStreams())
+        {
+            const uint16 streamId = stream->getStreamId();
+
+            if (!multiStream && streamId != currentStream)
+                continue;
+
+            if (windowSize > 0)
+                windowBuffers[streamId].prepare(getNumBlockChannels(streamId), windowSize, windowHop);
+
+            if (decimationFactor > 1)
+                decimators[streamId].prepare(getNumBlockChannels(streamId), decimationFactor);
+        }
+    }
+
+    if (moduleReady && outOfProcess)
+    {
+        workerProcess->setAcquisitionActive(true);
+        workerProcess->callMethod("start_acquisition");
+        return true;
+    }
+
+    if (moduleReady)
+    {
+        {
+            py::gil_scoped_acquire acquire;
+
+            prepareArrayPools();
+
+            if (nativeKernel.isSet() && !canUseNativeKernel())
+                LOGC("The native process kernel needs sync in-process mode on one stream, without windows, "
+                     "decimation or a deadline; calling process() instead");
+            else if (nativeKernel.isSet())
+                kernelChannels.resize(getNumBlockChannels(currentStream) + getNumOutputChannels(currentStream));
+
+            for (auto target : getAllCallbacks())
+            {
+                if (target->startAcquisition)
+                {
+                    try {
+                        PyCallbacks::call(target->startAcquisition);
+                    }
+                    catch (py::error_already_set& e) {
+                        handlePythonException("Python Exception!", "Error when starting acquisition in Python:", e);
+                    }
+                }
+            }
+        }
+
+        if (asyncMode)
+        {
+            // Slots hold the largest block or spike waveform, so the processing thread never allocates
+            size_t maxItemSamples = 0;
+
+            for (auto stream : getDataStreams())
+            {
+                if (multiStream || stream->getStreamId() == currentStream)
+                    maxItemSamples = jmax(maxItemSamples, (size_t) getNumBlockChannels(stream->getStreamId()) * maxQueuedBlockSamples);
+            }
+
+            for (auto spikeChannel : spikeChannels)
+                maxItemSamples = jmax(maxItemSamples, (size_t) spikeChannel->getNumChannels() * spikeChannel->getTotalSamples());
+
+            blockQueue.prepare(queueDepth, overflowPolicy, maxItemSamples);
+            asyncBlocks.clear();
+            asyncBlocks.reserve(getDataStreams().size());
+            asyncBlockIndex = 0;
+
+            {
+                py::gil_scoped_acquire acquire;
+                queuedBlocks = py::object();
+            }
+
+            asyncWorker->startThread();
+        }
+
+        if (isDeadlineActive())
+        {
+            // Events wait here for the next block Python runs, so slots hold the largest spike waveform
+            size_t maxSpikeSamples = 0;
+
+            for (auto spikeChannel : spikeChannels)
+                maxSpikeSamples = jmax(maxSpikeSamples, (size_t) spikeChannel->getNumChannels() * spikeChannel->getTotalSamples());
+
+            deadlineEvents.prepare(maxDeadlineEvents, BlockQueue::DROP_NEWEST, maxSpikeSamples);
+            deadlineBlocks.clear();
+            deadlineBlocks.reserve(getDataStreams().size());
+
+            deadlineWorker->startThread();
+        }
+
+        for (auto shard : streamShards)
+            shard->startThread();
+
+        return true;
+    }
+    return false;
+}
+
+bool PythonProcessor::stopAcquisition()
+{
+    // Readers keep the segment and its last data until the next acquisition
+    streamExporter.setAcquisitionActive(false);
+
+    // Let the worker finish its current item before Python is stopped
+    blockQueue.close();
+    deadlineEvents.close();
+    asyncWorker->stopThread(5000);
+    deadlineWorker->stopThread(5000);
+
+    if (deadlineEvents.getNumDropped() > 0)
+        LOGE(deadlineEvents.getNumDropped(), " TTL events and spikes were dropped while Python was late");
+
+    if (outputEvents.getNumDropped() > 0)
+        LOGE(outputEvents.getNumDropped(), " events from Python were dropped because the output event queue was full");
+
+    for (auto shard : streamShards)
+        shard->stopThread(5000);
+
+    // A reload still in progress takes over before the acquisition ends. The loader stops
+    // waiting for a block boundary, so the swap and teardown are done here instead
+    moduleLoader->signalThreadShouldExit();
+    moduleLoader->waitForThreadToExit(10000);
+
+    // Blocks left by a missed deadline
+    if (!streamBlocks.empty() || pendingModuleReady)
+    {
+        py::gil_scoped_acquire acquire;
+        streamBlocks.clear();
+        applyPendingModule();
+        retireModule();
+    }
+
+    if (saveLatencyStats && callbackStats.process.getCount() > 0)
+    {
+        File statsFile = File(CoreServices::getDefaultUserSaveDirectory())
+                            .getChildFile(String(moduleName) + "_latency_"
+                                          + Time::getCurrentTime().formatted("%Y-%m-%d_%H-%M-%S") + ".csv");
+
+        if (callbackStats.writeCsv(statsFile.getFullPathName().toStdString()))
+            LOGC("Saved Python callback latencies to ", statsFile.getFullPathName());
+        else
+            LOGE("Unable to write Python callback latencies to ", statsFile.getFullPathName());
+    }
+
+    if (moduleReady && outOfProcess)
+    {
+        workerProcess->setAcquisitionActive(false);
+        workerProcess->callMethod("stop_acquisition");
+    }
+    else if (moduleReady)
+    {
+        py::gil_scoped_acquire acquire;
+
+        for (auto target : getAllCallbacks())
+        {
+            if (target->stopAcquisition)
+            {
+                try {
+                    PyCallbacks::call(target->stopAcquisition);
+                }
+                catch (py::error_already_set& e) {
+                    handlePythonException("Python Exception!", "Error when stopping acquisition in Python:", e);
+                }
+            }
+        }
+    }
+
+    // A warm-up that finished during acquisition imports its script now
+    acquiring = false;
+
+    if (warmupActive && !warmupThread->isThreadRunning())
+        finishWarmup();
+
+    return true;
+}
+
+void PythonProcessor::startRecording() 
+{
+    String recordingDirectory = CoreServices::getRecordingDirectoryName();
+
+    if (moduleReady && outOfProcess)
+    {
+        workerProcess->callMethod("start_recording", recordingDirectory);
+        return;
+    }
+
+    py::gil_scoped_acquire acquire;
+
+    if (!moduleReady)
+        return;
+
+    for (auto target : getAllCallbacks())
+    {
+        if (target->startRecording)
+        {
+            try {
+                PyCallbacks::call(target->startRecording, recordingDirectory.toRawUTF8());
+            }
+            catch (py::error_already_set& e) {
+                handlePythonException("Python Exception!", "Error when starting recording in Python:", e);
+            }
         }
     }
-}
+}
+
+
+
+void PythonProcessor::stopRecording() 
+{
+    if (moduleReady && outOfProcess)
+    {
+        workerProcess->callMethod("stop_recording");
+        return;
+    }
 
+    py::gil_scoped_acquire acquire;
 
+    if (!moduleReady)
+        return;
 
-void PythonProcessor::stopRecording() 
-{
-    // py::gil_scoped_acquire acquire;
-    if(moduleReady && py::hasattr(*pyObject, "stop_recording"))
+    for (auto target : getAllCallbacks())
     {
-        try {
-            pyObject->attr("stop_recording")();
-        }
-        catch (py::error_already_set& e) {
-            handlePythonException("Python Exception!", "Error when stopping recording in Python:", e);
+        if (target->stopRecording)
+        {
+            try {
+                PyCallbacks::call(target->stopRecording);
+            }
+            catch (py::error_already_set& e) {
+                handlePythonException("Python Exception!", "Error when stopping recording in Python:", e);
+            }
         }
     }
 }
@@ -353,14 +2357,129 @@ void PythonProcessor::parameterValueChanged(Parameter* param)
         if( !scriptPath.equalsIgnoreCase(newScriptPath) )
         {
             scriptPath = newScriptPath;
-            importModule();
-            initModule();
+
+            // The worker process imports the script itself
+            if (outOfProcess || Py_IsInitialized() == 0)
+            {
+                importModule();
+                initModule();
+            }
+            else
+            {
+                startWarmup();
+            }
         }
     }
     else if (param->getName().equalsIgnoreCase("python_home")) 
     {
         initInterpreter(param->getValueAsString());
     }
+    else if (param->getName().equalsIgnoreCase("export_stream"))
+    {
+        exportEnabled = (bool) param->getValue();
+
+        if (!exportEnabled)
+            streamExporter.close();
+    }
+    else if (param->getName().equalsIgnoreCase("zero_copy"))
+    {
+        zeroCopy = (bool) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("async_mode"))
+    {
+        asyncMode = (bool) param->getValue();
+
+        if (moduleReady && numStreamWorkers > 0)
+            initModule();
+        else
+            updateOutputChannels();
+    }
+    else if (param->getName().equalsIgnoreCase("out_of_process"))
+    {
+        outOfProcess = (bool) param->getValue();
+
+        if (scriptPath.isNotEmpty())
+        {
+            importModule();
+            initModule();
+        }
+    }
+    else if (param->getName().equalsIgnoreCase("selected_channels"))
+    {
+        selectedChannelsText = param->getValueAsString().trim();
+
+        if (moduleReady)
+            initModule();
+    }
+    else if (param->getName().equalsIgnoreCase("window_size"))
+    {
+        windowSize = (int) param->getValue();
+
+        // Stream shards process whole blocks
+        if (moduleReady && numStreamWorkers > 0)
+            initModule();
+        else
+            updateOutputChannels();
+    }
+    else if (param->getName().equalsIgnoreCase("decimation"))
+    {
+        decimationFactor = (int) param->getValue();
+
+        // The module is constructed with the decimated sample rate
+        if (moduleReady)
+            initModule();
+    }
+    else if (param->getName().equalsIgnoreCase("window_hop"))
+    {
+        windowHop = (int) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("dtype") || param->getName().equalsIgnoreCase("int16_scale"))
+    {
+        sampleConverter.setFormat((SampleConverter::Format) (int) getParameter("dtype")->getValue(),
+                                  (float) getParameter("int16_scale")->getValue());
+    }
+    else if (param->getName().equalsIgnoreCase("deadline_policy"))
+    {
+        deadlinePolicy = (DeadlinePolicy) (int) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("deadline_percent"))
+    {
+        deadlinePercent = (int) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("max_missed_blocks"))
+    {
+        maxMissedBlocks = (int) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("read_only"))
+    {
+        readOnly = (bool) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("save_latency"))
+    {
+        saveLatencyStats = (bool) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("multi_stream"))
+    {
+        multiStream = (bool) param->getValue();
+
+        if (moduleReady)
+            initModule();
+    }
+    else if (param->getName().equalsIgnoreCase("stream_workers"))
+    {
+        numStreamWorkers = (int) param->getValue();
+
+        if (moduleReady)
+            initModule();
+    }
+    else if (param->getName().equalsIgnoreCase("queue_depth"))
+    {
+        queueDepth = (int) param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("overflow_policy"))
+    {
+        overflowPolicy = (BlockQueue::OverflowPolicy) (int) param->getValue();
+    }
     else if (param->getName().equalsIgnoreCase("current_stream"))
     {
         uint16 candidateStream = (uint16) (int) param->getValue();
@@ -455,9 +2574,14 @@ bool PythonProcessor::initInterpreter(String pythonHome)
             for (auto p : path) {
                 LOGD(p.cast<std::string>());
             }
+
+            setBytecodeCache();
         }
         LOGC("Python Interpreter initialized successfully! Python Home: ", String(Py_GetPythonHome()));
         CoreServices::sendStatusMessage("Python Home: " + String(Py_GetPythonHome()));
+
+        // Release the GIL so the processing and worker threads can acquire it
+        mainThreadState = PyEval_SaveThread();
         return true;
     }
     catch(py::error_already_set& e)
@@ -465,10 +2589,149 @@ bool PythonProcessor::initInterpreter(String pythonHome)
         String errText = "Unable to initialize Python Interpreter!";
         LOGE(errText);
         handlePythonException(errText, "", e);
+
+        if (Py_IsInitialized() > 0)
+            mainThreadState = PyEval_SaveThread();
+
         return false;
     }
 }
 
+void PythonProcessor::setBytecodeCache()
+{
+    File cacheDir = File::getSpecialLocation(File::userApplicationDataDirectory)
+                        .getChildFile("Open Ephys")
+                        .getChildFile("python-processor")
+                        .getChildFile("pycache");
+
+    Result result = cacheDir.createDirectory();
+
+    if (result.failed())
+    {
+        LOGE("Unable to create Python bytecode cache: ", result.getErrorMessage());
+        return;
+    }
+
+    // Bytecode of every module is written here instead of next to its source. The first import
+    // of each installed package compiles it again, later imports reuse the cache
+    py::module_ sys = py::module_::import("sys");
+    sys.attr("dont_write_bytecode") = false;
+    sys.attr("pycache_prefix") = cacheDir.getFullPathName().toStdString();
+
+    LOGD("Python bytecode cache: ", cacheDir.getFullPathName());
+}
+
+void PythonProcessor::startWarmup()
+{
+    // Only one warm-up at a time: a running one stops after its current import, and
+    // finishWarmup() then starts this one, so the message thread never waits for an import
+    if (warmupThread->isThreadRunning())
+    {
+        warmupThread->signalThreadShouldExit();
+        warmupRestart = true;
+
+        if (editorPtr != nullptr)
+            editorPtr->setStatusText("Loading Python modules...");
+
+        return;
+    }
+
+    warmupModules = StringArray::fromTokens(getParameter("preload_modules")->getValueAsString(), ",", "");
+    warmupModules.trim();
+    warmupModules.removeEmptyStrings();
+
+    warmupScriptPath = outOfProcess ? String() : scriptPath;
+    warmupPending = warmupScriptPath.isNotEmpty();
+    warmupActive = true;
+    warmupGeneration++;
+
+    if (editorPtr != nullptr)
+        editorPtr->setStatusText("Loading Python modules...");
+
+    warmupThread->startThread();
+}
+
+void PythonProcessor::warmUp()
+{
+    const double startTime = Time::getMillisecondCounterHiRes();
+
+    StringArray modules = warmupModules;
+
+    if (warmupScriptPath.isNotEmpty())
+    {
+        // importModule() appends the folder again; the duplicate entry is harmless
+        File script(warmupScriptPath);
+        py::module_::import("sys").attr("path").attr("append")(script.getParentDirectory().getFullPathName().toStdString());
+        modules.add(script.getFileNameWithoutExtension());
+    }
+
+    for (auto& name : modules)
+    {
+        // A newer warm-up is waiting to start
+        if (warmupThread->threadShouldExit())
+            break;
+
+        try
+        {
+            py::module_::import(name.toRawUTF8());
+        }
+        catch (py::error_already_set& e)
+        {
+            // A failed script import is reported again when importModule() retries it
+            LOGE("Unable to preload Python module ", name, ": ", e.what());
+        }
+    }
+
+    warmupSeconds = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    LOGC("Python modules loaded in ", warmupSeconds, " s");
+
+    // Skipped if the processor has been deleted, or a newer warm-up has started since
+    std::weak_ptr<bool> alive = aliveToken;
+    const int generation = warmupGeneration;
+
+    MessageManager::callAsync([this, alive, generation]
+    {
+        if (alive.lock() != nullptr && generation == warmupGeneration)
+            finishWarmup();
+    });
+}
+
+void PythonProcessor::finishWarmup()
+{
+    // warmUp() has returned by now, so the thread is only exiting
+    if (!warmupActive || !warmupThread->waitForThreadToExit(maxWarmupWaitMs))
+        return;
+
+    // The script or modules changed while the last warm-up was loading
+    if (warmupRestart)
+    {
+        warmupRestart = false;
+        startWarmup();
+        return;
+    }
+
+    // The processing thread may be running the previous script
+    if (acquiring)
+    {
+        if (editorPtr != nullptr)
+            editorPtr->setStatusText("Python ready, the script loads when acquisition stops");
+
+        return;
+    }
+
+    warmupActive = false;
+
+    if (editorPtr != nullptr)
+        editorPtr->setStatusText("Python ready (" + String(warmupSeconds, 1) + " s)");
+
+    if (warmupPending)
+    {
+        warmupPending = false;
+        importModule();
+        initModule();
+    }
+}
+
 bool PythonProcessor::importModule()
 {
 
@@ -477,10 +2740,21 @@ bool PythonProcessor::importModule()
         return false;
     }
 
+    if (outOfProcess)
+    {
+        // The script is imported by the worker process when initModule() launches it
+        moduleName = File(scriptPath).getFileNameWithoutExtension().toStdString();
+        editorPtr->setPathLabelText(moduleName, scriptPath);
+        moduleReady = true;
+        return true;
+    }
+
     LOGC("Importing Python module from ", scriptPath.toRawUTF8());
 
     MouseCursor::showWaitCursor();
 
+    py::gil_scoped_acquire acquire;
+
     try
     {
         // Clear for new class
@@ -524,7 +2798,30 @@ bool PythonProcessor::importModule()
 
 void PythonProcessor::reload() 
 {
-    // py::gil_scoped_acquire acquire;
+    if (outOfProcess)
+    {
+        // Relaunching the worker imports the script from disk again
+        moduleReady = scriptPath.isNotEmpty();
+        initModule();
+        return;
+    }
+
+    // During acquisition the new version is built in the background and swapped in between blocks
+    if (CoreServices::getAcquisitionStatus())
+    {
+        if (pyModule == nullptr)
+            LOGC("There is no module to reload");
+        else if (streamShards.size() > 0)
+            LOGE("Reloading during acquisition is not available with stream workers");
+        else if (moduleLoader->isThreadRunning() || pendingModuleReady)
+            LOGC("A reload is already in progress");
+        else
+            moduleLoader->startThread();
+
+        return;
+    }
+
+    py::gil_scoped_acquire acquire;
 
     if (pyModule)
     {
@@ -549,33 +2846,218 @@ void PythonProcessor::reload()
     }
 }
 
+py::object PythonProcessor::createPyProcessor()
+{
+    if (multiStream)
+    {
+        // Channel counts and sample rates keyed by stream ID, matching the dict passed to process()
+        py::dict streamChannels;
+        py::dict streamSampleRates;
+
+        for (auto stream : getDataStreams())
+        {
+            streamChannels[py::int_(stream->getStreamId())] = stream->getChannelCount();
+            streamSampleRates[py::int_(stream->getStreamId())] = stream->getSampleRate() / decimationFactor;
+        }
+
+        LOGC("Initializing module with ", (int) streamChannels.size(), " streams");
+        return pyModule->attr("PyProcessor")(this, streamChannels, streamSampleRates);
+    }
+
+    const int numChans = getNumInputChannels(currentStream);
+
+    // Python only ever sees the decimated rate
+    const float sampleRate = getDataStream(currentStream)->getSampleRate() / decimationFactor;
+
+    LOGC("Initializing module with ", numChans, " channels at ", sampleRate, " Hz");
+    return pyModule->attr("PyProcessor")(this, numChans, sampleRate);
+}
+
+void PythonProcessor::loadPendingModule()
+{
+    LOGC("Reloading module in the background...");
+
+    try
+    {
+        pyModule->reload();
+
+        pendingKernel.clear();
+        pendingKernelOwner = py::object();
+
+        loadingPendingModule = true;
+        py::object instance;
+
+        try
+        {
+            instance = createPyProcessor();
+        }
+        catch (py::error_already_set&)
+        {
+            loadingPendingModule = false;
+            throw;
+        }
+
+        loadingPendingModule = false;
+        pendingCallbacks.resolve(instance);
+
+        // Started here rather than at the swap, so the processing thread never waits on Python.
+        // The running version carries on until then, so the state it hands over may be a few blocks old
+        if (pendingCallbacks.startAcquisition)
+            PyCallbacks::call(pendingCallbacks.startAcquisition);
+
+        // Lets the new version carry over filter state etc. from the one it replaces
+        if (pyObject != nullptr && py::hasattr(instance, "transfer_state"))
+            PyCallbacks::call(instance.attr("transfer_state"), *pyObject);
+
+        pendingObject = new py::object(instance);
+        pendingModuleReady = true;
+
+        LOGC("Module reloaded, switching over at the next block");
+    }
+    catch (py::error_already_set& e)
+    {
+        // The running version carries on
+        pendingCallbacks.clear();
+        pendingKernel.clear();
+        pendingKernelOwner = py::object();
+        LOGE("Reloading module failed:\n", e.what());
+    }
+}
+
+void PythonProcessor::applyPendingModule()
+{
+    if (!pendingModuleReady)
+        return;
+
+    // References are moved, never copied or dropped, so no Python code runs here
+    retiredObject = pyObject;
+    retiredCallbacks = std::move(callbacks);
+    retiredKernelOwner = std::move(nativeKernelOwner);
+
+    pyObject = pendingObject;
+    callbacks = std::move(pendingCallbacks);
+    pendingObject = nullptr;
+
+    // The kernel goes with the instance that registered it, or stops if the new one has none
+    nativeKernel.takeFrom(pendingKernel);
+    nativeKernelOwner = std::move(pendingKernelOwner);
+
+    moduleReady = true;
+
+    // Hands the old instance to the module loader
+    pendingModuleReady = false;
+}
+
+void PythonProcessor::retireModule()
+{
+    // Not swapped yet: stopAcquisition() swaps and retires it instead
+    if (pendingModuleReady || retiredObject == nullptr)
+        return;
+
+    LOGC("Switched to the reloaded module");
+
+    try
+    {
+        if (retiredCallbacks.stopAcquisition)
+            PyCallbacks::call(retiredCallbacks.stopAcquisition);
+    }
+    catch (py::error_already_set& e)
+    {
+        LOGE("Error when stopping the previous module version:\n", e.what());
+    }
+
+    retiredCallbacks.clear();
+    retiredKernelOwner = py::object();
+    delete retiredObject;
+    retiredObject = nullptr;
+}
+
 void PythonProcessor::initModule()
 {
     int numChans = 0;
-    float sampleRate = 0;
+
+    // Only set for in-process scripts, once the module has been constructed
+    selectedChannels.clear();
+    scriptReadOnly = false;
     
-    if(currentStream > 0)
+    if (multiStream)
+    {
+        if (getDataStreams().size() == 0)
+            return;
+    }
+    else if(currentStream > 0)
     {
-        numChans = getDataStream(currentStream)->getChannelCount();
-        sampleRate = getDataStream(currentStream)->getSampleRate();
+        numChans = getNumInputChannels(currentStream);
     }
     else
     {
         return;
     }
 
-    if (moduleReady)
+    if (moduleReady && outOfProcess)
+    {
+        launchWorkerProcess();
+    }
+    else if (moduleReady)
     {
-        LOGC("Initializing module with ", numChans, " channels at ", sampleRate, " Hz");
-        // py::gil_scoped_acquire acquire;
+        py::gil_scoped_acquire acquire;
+        callbacks.clear();
+        spikeBatch.clear();
+        ttlBatch.clear();
+        updateChannelTables();
+
+        // The new instance registers its own kernel in __init__, if it has one
+        nativeKernel.clear();
+        nativeKernelOwner = py::object();
+
         if (pyObject)
         {
             delete pyObject;
             pyObject = NULL;
         }
 
+        clearStreamShards();
+
         try {
-            pyObject = new py::object(pyModule->attr("PyProcessor")(this, numChans, sampleRate));
+            // Scripts that never modify their input can declare read_only = True on the class
+            scriptReadOnly = py::bool_(py::getattr(pyModule->attr("PyProcessor"), "read_only", py::bool_(false)));
+
+            if (multiStream && numStreamWorkers > 0 && !asyncMode && windowSize == 0)
+            {
+                // Streams are dealt round-robin to the shards, each with its own PyProcessor
+                const int numShards = jmin(numStreamWorkers, getDataStreams().size());
+
+                for (int i = 0; i < numShards; ++i)
+                    streamShards.add(new StreamShard(this, i));
+
+                for (int i = 0; i < getDataStreams().size(); ++i)
+                    streamShards[i % numShards]->streamIds.add(getDataStreams()[i]->getStreamId());
+
+                for (auto shard : streamShards)
+                {
+                    py::dict streamChannels;
+                    py::dict streamSampleRates;
+
+                    for (auto streamId : shard->streamIds)
+                    {
+                        streamChannels[py::int_(streamId)] = getDataStream(streamId)->getChannelCount();
+                        streamSampleRates[py::int_(streamId)] = getDataStream(streamId)->getSampleRate() / decimationFactor;
+                    }
+
+                    shard->pyObject = new py::object(pyModule->attr("PyProcessor")(this, streamChannels, streamSampleRates));
+                    shard->callbacks.resolve(*shard->pyObject);
+                }
+
+                LOGC("Initialized module on ", numShards, " stream shards");
+            }
+            else
+            {
+                pyObject = new py::object(createPyProcessor());
+                callbacks.resolve(*pyObject);
+
+                if (!multiStream)
+                    updateSelectedChannels(numChans);
+            }
         }
 
         catch (py::error_already_set& e)
@@ -585,6 +3067,36 @@ void PythonProcessor::initModule()
             handlePythonException("Python Exception!", errText, e);
         }
     }
+
+    updateOutputChannels();
+}
+
+void PythonProcessor::launchWorkerProcess()
+{
+    // The worker process only handles the selected stream
+    if (!streamExists(currentStream))
+        return;
+
+    const int numChans = getDataStream(currentStream)->getChannelCount();
+    const float sampleRate = getDataStream(currentStream)->getSampleRate();
+
+    File pythonHome(getParameter("python_home")->getValueAsString());
+    File pythonExecutable = pythonHome.getChildFile("bin/python3");
+
+    if (!pythonExecutable.existsAsFile())
+        pythonExecutable = pythonHome.getChildFile("bin/python");
+
+    LOGC("Launching Python worker for ", moduleName, " with ", numChans, " channels at ", sampleRate, " Hz");
+
+    MouseCursor::showWaitCursor();
+    const bool launched = workerProcess->launch(pythonExecutable.getFullPathName(), scriptPath, numChans, sampleRate);
+    MouseCursor::hideWaitCursor();
+
+    if (!launched)
+    {
+        moduleReady = false;
+        editorPtr->setPathLabelText("(ERROR) " + moduleName, scriptPath);
+    }
 }
 
 void PythonProcessor::handlePythonException(const String& title, const String& msg, py::error_already_set e)
@@ -611,7 +3123,11 @@ void PythonProcessor::handlePythonException(const String& title, const String& m
     exceptionWindow.addButton("OK", 1, dismissKey);
     exceptionWindow.addCustomComponent(customMsgBox);
 
-    exceptionWindow.runModalLoop();
+    {
+        // Don't hold the interpreter while the dialog is open
+        py::gil_scoped_release release;
+        exceptionWindow.runModalLoop();
+    }
 
     moduleReady = false;
     editorPtr->setPathLabelText("(ERROR) " + moduleName, scriptPath);
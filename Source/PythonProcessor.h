@@ -28,9 +28,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <pybind11/embed.h>
 #include <pybind11/numpy.h>
 
-#include <queue>
-
 #include "PythonProcessorEditor.h"
+#include "BlockQueue.h"
+#include "AsyncWorker.h"
+#include "StreamShard.h"
+#include "WorkerProcess.h"
+#include "CallbackStats.h"
+#include "PyCallbacks.h"
+#include "SpikeBatch.h"
+#include "TTLBatch.h"
+#include "OutputEventQueue.h"
+#include "WindowBuffer.h"
+#include "Decimator.h"
+#include "SampleConverter.h"
+#include "ArrayPool.h"
+#include "ModuleBindings.h"
+#include "DeadlineWorker.h"
+#include "ModuleLoader.h"
+#include "InterpreterWarmup.h"
+#include "StreamExporter.h"
+#include "NativeKernel.h"
+#include "BlockRunner.h"
 
 namespace py = pybind11;
 
@@ -48,6 +66,29 @@ private:
 	/** Instance of user-defined python class*/
 	py::object* pyObject;
 
+	/** Bound methods of pyObject, resolved in initModule() */
+	PyCallbacks callbacks;
+
+	/** Spikes waiting for handle_spikes() in the current block */
+	SpikeBatch spikeBatch;
+
+	/** (source_node, name, num_channels, num_samples) of each spike channel,
+		indexed by the electrode indices passed to handle_spikes() */
+	py::object electrodeTable;
+
+	/** Position of each spike channel in electrodeTable */
+	std::map<const SpikeChannel*, int> electrodeIndices;
+
+	/** TTL events waiting for handle_ttl_events() in the current block */
+	TTLBatch ttlBatch;
+
+	/** (source_node, name) of each TTL channel, indexed by the
+		channel indices passed to handle_ttl_events() */
+	py::object eventChannelTable;
+
+	/** Position of each TTL channel in eventChannelTable */
+	std::map<const EventChannel*, int> eventChannelIndices;
+
 	/** File path to python script */
 	String scriptPath;
 
@@ -55,7 +96,11 @@ private:
 	std::string moduleName;
 
 	/** True if there is an module loaded with no exceptions*/
-	bool moduleReady;
+	std::atomic<bool> moduleReady;
+
+	/** Thread state saved when the GIL is released after initializing the interpreter.
+		Only set for the processor that owns the interpreter. */
+	PyThreadState* mainThreadState;
 
 	/** Pointer to editor */
 	PythonProcessorEditor* editorPtr;
@@ -63,20 +108,441 @@ private:
 	/** Stream to process*/
 	uint16 currentStream;
 
+	/** True if Python should receive a view of the AudioBuffer instead of a copy */
+	bool zeroCopy;
+
+	/** Set when the script keeps a view past process(): later blocks get copies until acquisition restarts */
+	bool viewKept;
+
+	/** True if Python runs on the worker thread instead of the processing thread */
+	bool asyncMode;
+
+	/** True if every stream is passed to Python instead of only currentStream */
+	bool multiStream;
+
+	/** True if the data is passed to Python read-only and not written back, set in the editor */
+	bool readOnly;
+
+	/** True if the script's PyProcessor class declares read_only = True */
+	bool scriptReadOnly;
+
+	/** Window mode settings. windowSize is 0 when Python receives whole blocks */
+	int windowSize;
+	int windowHop;
+
+	/** Sample history of each stream in window mode */
+	std::map<uint16, WindowBuffer> windowBuffers;
+
+	/** float32 window read from a WindowBuffer before conversion to the selected dtype */
+	std::vector<float> windowScratch;
+
+	/** Downsampling factor applied before Python; 1 passes the full-rate data */
+	int decimationFactor;
+
+	/** Anti-alias filter and decimator of each stream when decimationFactor > 1 */
+	std::map<uint16, Decimator> decimators;
+
+	/** Converts the data passed to Python to the dtype selected in the editor */
+	SampleConverter sampleConverter;
+
+	/** Arrays reused for the blocks, windows and spike waveforms passed to Python,
+		keyed by stream ID (electrode index for spikes). Prepared in startAcquisition() */
+	ArrayPool blockArrays;
+	ArrayPool windowArrays;
+	ArrayPool spikeArrays;
+
+	/** Output channels passed to Python when they cannot be a view of the AudioBuffer */
+	ArrayPool outputArrays;
+
+	/** Samples per channel allocated for each stream's block array, before any larger block is seen */
+	static const int initialBlockSamples = 1024;
+
+	/** Longest block per channel the async queue's slots hold. Longer blocks are dropped */
+	static const int maxQueuedBlockSamples = 4096;
+
+	/** Names of the continuous channels added to outputStream for the script's output_channels.
+		Set in updateSettings() */
+	StringArray outputChannelNames;
+	uint16 outputStream;
+
+	/** Channels of currentStream passed to Python, as local indices. Empty means all channels */
+	Array<int> selectedChannels;
+
+	/** Channel selection entered in the editor, overriding the script's selected_channels */
+	String selectedChannelsText;
+
+	/** True if the script runs in a separate Python process */
+	bool outOfProcess;
+
+	/** Child process running the script when outOfProcess is set */
+	std::unique_ptr<WorkerProcess> workerProcess;
+
+	/** Timing of each Python callback during the current acquisition */
+	CallbackStats callbackStats;
+
+	/** Event flushing, block conversion and kernel calls, shared with the benchmark */
+	BlockRunner blockRunner;
+
+	/** True if callbackStats should be written to CSV when acquisition stops */
+	bool saveLatencyStats;
+
+	/** Number of stream shards to process in parallel in multi-stream mode */
+	int numStreamWorkers;
+
+	/** Stream groups with their own PyProcessor and thread. Empty unless stream workers are enabled */
+	OwnedArray<StreamShard> streamShards;
+
+	/** What process() does with a block Python has not finished by its deadline */
+	enum DeadlinePolicy
+	{
+		WAIT_FOR_PYTHON = 0,
+		PASS_THROUGH,
+		REUSE_LAST_OUTPUT
+	};
+
+	/** Deadline settings. The deadline is deadlinePercent of the block duration */
+	DeadlinePolicy deadlinePolicy;
+	int deadlinePercent;
+
+	/** Consecutive blocks without Python output after which the script is stopped (0 = never) */
+	int maxMissedBlocks;
+
+	/** Blocks without Python output since the last one on time. Processing thread only */
+	int consecutiveMisses;
+
+	/** Runs Python for each block when a deadline policy is set */
+	std::unique_ptr<DeadlineWorker> deadlineWorker;
+
+	/** Each stream's channels after the last block Python finished on time, for REUSE_LAST_OUTPUT */
+	std::map<uint16, AudioBuffer<float>> lastOutputs;
+
+	/** Reloads the script in the background when reload() is called during acquisition */
+	std::unique_ptr<ModuleLoader> moduleLoader;
+
+	/** Instance built by moduleLoader, waiting to replace pyObject at a block boundary.
+		Owned by moduleLoader until pendingModuleReady is set */
+	py::object* pendingObject;
+	PyCallbacks pendingCallbacks;
+	std::atomic<bool> pendingModuleReady;
+
+	/** Instance replaced by pendingObject, stopped and deleted by moduleLoader once
+		pendingModuleReady is cleared. Its kernel owner is released with it */
+	py::object* retiredObject;
+	PyCallbacks retiredCallbacks;
+	py::object retiredKernelOwner;
+
+	/** Compiled kernel registered by the script, called instead of process() without the GIL.
+		The owner keeps the Python object holding the function alive */
+	NativeKernel nativeKernel;
+	py::object nativeKernelOwner;
+
+	/** Kernel registered by the instance moduleLoader is building, swapped in with it */
+	NativeKernel pendingKernel;
+	py::object pendingKernelOwner;
+
+	/** True while loadPendingModule() builds the reloaded instance. GIL must be held */
+	bool loadingPendingModule;
+
+	/** Channel pointers passed to the kernel. Sized in startAcquisition() */
+	std::vector<float*> kernelChannels;
+
+	/** Imports preloaded modules and the script in the background when the plugin loads */
+	std::unique_ptr<InterpreterWarmup> warmupThread;
+
+	/** Modules and script imported by warmupThread, copied when it starts */
+	StringArray warmupModules;
+	String warmupScriptPath;
+
+	/** True from startWarmup() until finishWarmup() has run, and while the script still has to be
+		imported and initialized after it. Message thread only */
+	bool warmupActive;
+	bool warmupPending;
+
+	/** Set when startWarmup() is called while a warm-up is running, which then stops early
+		and is followed by a new one. Message thread only */
+	bool warmupRestart;
+
+	/** True between startAcquisition() and stopAcquisition(). Message thread only */
+	bool acquiring;
+
+	/** Longest the message thread waits for the warm-up thread, when acquisition starts */
+	static const int maxWarmupWaitMs = 2000;
+
+	/** Incremented by each startWarmup(), so only the latest warm-up reports back */
+	int warmupGeneration;
+
+	/** Time taken by the last warm-up, in seconds */
+	double warmupSeconds;
+
+	/** Held by the processor for its whole lifetime, so callbacks posted by warmupThread
+		can tell whether it still exists */
+	std::shared_ptr<bool> aliveToken;
+
+	/** Starts importing the preloaded modules and the script in the background */
+	void startWarmup();
+
+	/** Imports and initializes the script once warmupThread has finished, then reports
+		readiness in the editor. Starts the next warm-up instead if one was requested, and
+		waits until acquisition stops before importing the script */
+	void finishWarmup();
+
+	/** Sets sys.pycache_prefix, so bytecode is cached even if the script's folder is read-only.
+		GIL must be held. */
+	void setBytecodeCache();
+
+	/** Publishes the selected stream and its events to shared memory, when enabled in the editor */
+	StreamExporter streamExporter;
+	bool exportEnabled;
+
+	/** Stream published by streamExporter, set when acquisition starts */
+	uint16 exportStream;
+
+	/** Copies the current block of exportStream into streamExporter */
+	void exportBlock(AudioBuffer<float>& buffer);
+
+	/** Reads the block's incoming events with checkForEvents(), noting that they have been read */
+	void readBlockEvents();
+
+	/** True once the current block's events have been read. Blocks that skip Python read
+		them in process() with exportEventsOnly set, so the export still gets them */
+	bool blockEventsRead;
+	bool exportEventsOnly;
+
+	/** Passes the current block to Python, as configured in the editor */
+	void processPython(AudioBuffer<float>& buffer);
+
+	/** Hands the block to the deadline worker and waits for it until the deadline, without taking the GIL */
+	void processWithDeadline(AudioBuffer<float>& buffer);
+
+	/** Moves the events in deadlineEvents into the batches. Deadline worker only, with the GIL held */
+	void batchDeadlineEvents();
+
+	/** Async mode settings */
+	int queueDepth;
+	BlockQueue::OverflowPolicy overflowPolicy;
+
+	/** Blocks and events waiting for the worker thread */
+	BlockQueue blockQueue;
+
+	/** Hands queued items to Python in async mode */
+	std::unique_ptr<AsyncWorker> asyncWorker;
+
+	/** A stream's block waiting to be queued at the end of process() in async mode,
+		or to be copied to Python by the deadline worker */
+	struct AsyncBlock
+	{
+		uint16 streamId;
+		int numChannels;
+		int numSamples;
+		int64 firstSample;
+	};
+
+	/** This block's streams, reserved in startAcquisition(). Processing thread only */
+	std::vector<AsyncBlock> asyncBlocks;
+	int64 asyncBlockIndex;
+
+	/** Streams of the block handed to the deadline worker. Written only while it is idle */
+	std::vector<AsyncBlock> deadlineBlocks;
+
+	/** TTL events and spikes read by the processing thread in deadline mode, batched by the
+		deadline worker for the next block Python runs, including those of skipped blocks */
+	BlockQueue deadlineEvents;
+
+	/** Events and spikes deadlineEvents holds before it drops new ones */
+	static const int maxDeadlineEvents = 1024;
+
+	/** Streams of a queued block gathered by the worker for one process() call in
+		multi-stream mode. Worker thread only, with the GIL held */
+	py::object queuedBlocks;
+	int64 queuedBlockIndex;
+	int queuedBlockSamples;
+	uint16 queuedBlockStream;
+	int64 queuedBlockFirstSample;
+
 	std::map<uint16, EventChannel*> localEventChannels;
 
-	struct StringTTL
-    {
-        int eventLine;
-		bool state;
-    };
+	/** A stream's block as handed to Python */
+	struct StreamBlock
+	{
+		uint16 streamId;
+		int numChannels;
+		int numSamples;
+		py::array data;
+
+		/** Sample number of the first sample in data, counted at the decimated rate if the stream is decimated */
+		int64 firstSample;
+
+		/** True if data is a view of the AudioBuffer rather than a copy */
+		bool isView;
+
+		/** Array passed to process() for the stream's output channels, or null if it has none */
+		py::object outputs;
+		bool outputsAreView = false;
+	};
+
+	/** Blocks passed to Python in the current process() call */
+	std::vector<StreamBlock> streamBlocks;
 
-	std::queue<StringTTL> TTLQueue;
-	CriticalSection TTLqueueLock;
+	/** TTL events emitted by Python, added to the output by process() */
+	OutputEventQueue outputEvents;
+
+	/** Full-rate first sample of the current stream's block whose events Python is handling.
+		Offsets of events emitted from the event hooks count from here */
+	int64 eventBlockSample;
+
+	/** First sample of the block the worker process replied to late, whose events are added once the reply arrives */
+	int64 lateWorkerBlockSample;
 
 	/**Check whether data stream exists */
 	bool streamExists(uint16 streamId);
 
+	/** True if the script cannot modify the data, from the editor or the script */
+	bool isReadOnly() const { return readOnly || scriptReadOnly; }
+
+	/** Number of channels of a stream passed to Python */
+	int getNumBlockChannels(uint16 streamId);
+
+	/** Number of channels of a stream, not counting the output channels added by this processor */
+	int getNumInputChannels(uint16 streamId);
+
+	/** Number of output channels added to a stream, and the global index of one of them */
+	int getNumOutputChannels(uint16 streamId) const { return streamId == outputStream ? outputChannelNames.size() : 0; }
+	int getOutputChannelIndex(uint16 streamId, int index);
+
+	/** True if the current settings can pass output channels to process(): whole blocks of a
+		single stream, at full rate, on the processing thread */
+	bool supportsOutputChannels() const;
+
+	/** Output channel names declared by the script's output_channels attribute, which is either
+		a number of channels or a list of names. Empty if the settings do not support them */
+	StringArray getScriptOutputChannels();
+
+	/** Updates the signal chain if the output channels declared by the script have changed.
+		Message thread only */
+	void updateOutputChannels();
+
+	/** Clears the output channels, so blocks without Python output pass zeros downstream */
+	void clearOutputChannels(AudioBuffer<float>& buffer);
+
+	/** Sets a block's output array: a view of the output channels where possible, otherwise a pooled
+		array written back by finishBlock() */
+	void prepareOutputs(AudioBuffer<float>& buffer, StreamBlock& block);
+
+	/** Global index of the channel at a given row of the array passed to Python */
+	int getBlockChannelIndex(uint16 streamId, int index);
+
+	/** Sets selectedChannels from the editor entry, or from the script's selected_channels attribute.
+		GIL must be held. */
+	void updateSelectedChannels(int numChans);
+
+	/** Returns the distance (in samples) between consecutive channels of a stream in the AudioBuffer,
+		or 0 if the channels are not evenly strided in memory */
+	ptrdiff_t getChannelStride(AudioBuffer<float>& buffer, uint16 streamId, int numChannels);
+
+	/** Wraps a stream's channels in the AudioBuffer as a (channels x samples) numpy array without copying */
+	py::array_t<float> getBufferView(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int numSamples, ptrdiff_t channelStride);
+
+	/** Passes every complete window of a stream to process(), with its first sample number. GIL must be held. */
+	void processWindows(uint16 streamId, WindowBuffer& history);
+
+	/** Replaces a block with its decimated samples if the stream is decimated.
+		Returns false if there is nothing to pass to Python */
+	bool decimateBlock(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int& numSamples, int64& firstSample);
+
+	/** Channel of the data passed to Python: the decimated signal, or the AudioBuffer */
+	const float* getBlockReadPointer(AudioBuffer<float>& buffer, uint16 streamId, int index);
+
+	/** Constructs a PyProcessor instance for the current stream, or every stream in multi-stream mode.
+		GIL must be held. */
+	py::object createPyProcessor();
+
+	/** Replaces pyObject with the instance built during acquisition, if there is one.
+		Only moves pointers and references, so it runs no Python and needs no GIL */
+	void applyPendingModule();
+
+	/** True if blocks can go to the native kernel: sync, in-process, one stream at full rate
+		without windows or a deadline */
+	bool canUseNativeKernel() const;
+
+	/** Passes the current stream's block to the native kernel, taking the GIL only for event hooks */
+	void processNativeKernel(AudioBuffer<float>& buffer);
+
+	/** Calls process() with the blocks in streamBlocks. GIL must be held. */
+	void callProcess();
+
+	/** Adds the TTL events emitted by Python to the current block */
+	void addOutputEvents();
+
+	/** Deadline of the current block, in milliseconds */
+	int getDeadlineMs();
+
+	/** Applies the deadline policy to a block Python did not finish, and stops the script
+		after maxMissedBlocks consecutive misses */
+	void handleMissedBlock(AudioBuffer<float>& buffer);
+
+	/** Keeps the channels written back by Python, for blocks that later miss their deadline */
+	void saveLastOutputs(AudioBuffer<float>& buffer);
+
+	/** Real-time duration of a block, in nanoseconds */
+	int64 getBlockBudget(uint16 streamId, int numSamples);
+
+	/** Sends the current stream's block and events to the worker process */
+	void processInWorkerProcess(AudioBuffer<float>& buffer);
+
+	/** (Re)starts the worker process for the current stream */
+	void launchWorkerProcess();
+
+	/** Wraps or copies a stream's channels into a numpy array for Python */
+	StreamBlock prepareBlock(AudioBuffer<float>& buffer, uint16 streamId, int numChannels, int numSamples, int64 firstSample);
+
+	/** Full-rate samples per sample passed to Python: the decimation factor if the stream is decimated, else 1 */
+	int getDecimation(uint16 streamId) const;
+
+	/** Full-rate sample number that a sample passed to Python describes. Decimated sample n
+		lags input sample n * factor by the anti-alias filter's delay */
+	int64 getFullRateSample(uint16 streamId, int64 sampleNumber) const;
+
+	/** Block whose samples the offsets of events emitted from process() count: the current stream's, if it was passed */
+	const StreamBlock& getEventOriginBlock(const std::vector<StreamBlock>& blocks) const;
+
+	/** Writes a block back into the AudioBuffer after Python has processed it */
+	void finishBlock(AudioBuffer<float>& buffer, StreamBlock& block);
+
+	/** Sets viewKept, with a warning, if the script still holds a view of the AudioBuffer */
+	void checkViewKept(const py::object& view);
+
+	/** Copies a stream's block into the async queue and wakes the worker */
+	void queueBlock(AudioBuffer<float>& buffer, const AsyncBlock& block, bool lastInBlock);
+
+	/** Allocates the pooled arrays for the current settings. GIL must be held. */
+	void prepareArrayPools();
+
+	/** Deletes the stream shards and their PyProcessor instances. GIL must be held. */
+	void clearStreamShards();
+
+	/** Callbacks of all PyProcessor instances that receive control calls (start_acquisition etc.) */
+	std::vector<PyCallbacks*> getAllCallbacks();
+
+	/** Callbacks of the PyProcessor instance that handles a given stream */
+	PyCallbacks* getStreamCallbacks(uint16 streamId);
+
+	/** The event batches of the PyProcessor instance that handles a given stream */
+	TTLBatch* getStreamTTLBatch(uint16 streamId);
+	SpikeBatch* getStreamSpikeBatch(uint16 streamId);
+
+	/** Passes every non-empty event batch to handle_ttl_events() / handle_spikes(). GIL must be held. */
+	void flushEventBatches();
+
+	/** Rebuilds the electrode and TTL channel tables from the spike and event channels. GIL must be held. */
+	void updateChannelTables();
+
+	/** Calls handle_ttl_event() if the module defines it. GIL must be held. */
+	void callTTLEventHook(PyCallbacks& target, int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state);
+
+	/** Calls handle_spike() if the module defines it. GIL must be held. */
+	void callSpikeHook(PyCallbacks& target, int sourceNodeId, const char* electrodeName, int numChans, int numSamples,
+					   int64 sampleNum, uint16 sortedId, py::array& spikeData);
+
 public:
 	/** The class constructor, used to initialize any members. */
 	PythonProcessor();
@@ -115,10 +581,27 @@ public:
 	// 	Called automatically whenever a broadcast message is sent through the signal chain */
 	// void handleBroadcastMessage(String message) override;
 
-	/**Add events from python to C++. Bound to Python as an embedded module*/
-	void addPythonEvent(int line, bool state);
+	/**Add events from python to C++. Bound to Python as an embedded module.
+		sampleOffset counts samples of the data Python is processing, from the first sample of its
+		block or window (of the current stream's block for event hooks), at the decimated rate if
+		decimation is on. Events from threads the script started count from the block they are added to */
+	void addPythonEvent(int line, bool state, int sampleOffset);
+
+	/** Vectorised addPythonEvent(). sampleOffsets may be None, meaning offset 0 for every event */
+	void addPythonEvents(py::array_t<int, py::array::c_style | py::array::forcecast> lines,
+						 py::array_t<bool, py::array::c_style | py::array::forcecast> states,
+						 py::object sampleOffsets);
+
+	/** Registers a compiled function that processes each block instead of the script's process(),
+		called without the GIL. Bound to Python; None unregisters it. See NativeKernel for the signatures */
+	void registerNativeProcess(py::object function, const std::string& signature);
 
-	void triggerTTLEvent(StringTTL TTLmsg, juce::int64 sampleNum);
+	/** Adds an event from Python to the output of the current stream's block starting at sampleNum.
+		An event whose sample has already passed is added at the start of the block with its own sample number */
+	void triggerTTLEvent(uint8 line, bool state, juce::int64 eventSample, juce::int64 sampleNum, int numSamples);
+
+	/** Converts a full-rate sample number of a stream's block to the current stream's clock */
+	int64 getCurrentStreamSample(uint16 streamId, int64 sampleNumber);
 
 	/** Called at the start of acquisition.*/
 	bool startAcquisition() override;
@@ -148,6 +631,60 @@ public:
 	/** Initializes the python script by calling __init__() */
 	void initModule();
 
+	/** Passes a block, TTL event or spike from the async queue to Python.
+		Called on the worker thread with the GIL held. */
+	void handleQueuedItem(QueuedItem& item);
+
+	/** Adds a queued stream block to queuedBlocks, calling process() after the block's last stream */
+	void queueStreamBlock(QueuedItem& item);
+
+	/** Passes the streams gathered in queuedBlocks to process() */
+	void flushQueuedBlocks();
+
+	/** Reloads the module, builds the instance for applyPendingModule() and calls its
+		start_acquisition() and transfer_state(old). Called on the module loader's thread with the GIL held. */
+	void loadPendingModule();
+
+	/** True while the reloaded instance waits for applyPendingModule() */
+	bool isModuleSwapPending() const { return pendingModuleReady; }
+
+	/** Calls stop_acquisition() on the instance applyPendingModule() replaced, and deletes it.
+		Called on the module loader's thread, or in stopAcquisition(), with the GIL held. */
+	void retireModule();
+
+	/** Imports the preloaded modules and the script, so importModule() finds them in sys.modules.
+		Called on the warm-up thread with the GIL held. */
+	void warmUp();
+
+	/** Passes the current block's events, windows and blocks to Python, copying the blocks
+		to and from buffer unless the block was abandoned.
+		Called on the deadline worker's thread with the GIL held. */
+	void processDeadlineBlock(AudioBuffer<float>& buffer);
+
+	/** True if process() stops waiting for Python after a deadline. Only sync
+		in-process mode without stream shards has a deadline */
+	bool isDeadlineActive() const { return deadlinePolicy != WAIT_FOR_PYTHON && !asyncMode && streamShards.size() == 0; }
+
+	/** Passes a shard's streams to its PyProcessor instance.
+		Called on the shard's thread with the GIL held. */
+	void processShard(StreamShard& shard, AudioBuffer<float>& buffer);
+
+	/** Async queue status, for display in the editor */
+	bool isAsyncMode() const { return asyncMode; }
+	int getNumQueuedItems() const { return blockQueue.getNumQueued(); }
+	int getQueueCapacity() const { return blockQueue.getCapacity(); }
+	int64 getNumDroppedItems() const { return blockQueue.getNumDropped(); }
+
+	/** Events from Python dropped because the output event queue was full, for display in the editor */
+	int64 getNumDroppedEvents() const { return outputEvents.getNumDropped(); }
+
+	/** Worker process status, for display in the editor */
+	bool isOutOfProcess() const { return outOfProcess; }
+	int getNumWorkerRestarts() const { return workerProcess->getNumRestarts(); }
+
+	/** Callback latencies, for display in the editor */
+	const CallbackStats& getCallbackStats() const { return callbackStats; }
+
 	/** Deals with python exceptions (print and turn off module for now) */
 	void handlePythonException(const String& title, const String& msg, py::error_already_set e);
 
@@ -51,13 +51,59 @@ void ScriptPathButton::resized()
 
 
 
+PythonSettingsPanel::PythonSettingsPanel(GenericProcessor* processor)
+{
+	// Grouped by feature, four to a row
+	const char* names[] = {
+		"async_mode", "queue_depth", "overflow_policy", "out_of_process",
+		"multi_stream", "stream_workers", "selected_channels", "read_only",
+		"zero_copy", "window_size", "window_hop", "decimation",
+		"dtype", "int16_scale", "deadline_policy", "deadline_percent",
+		"max_missed_blocks", "preload_modules", "save_latency", "export_stream",
+		"export_name", "export_seconds"
+	};
+
+	const int numColumns = 4;
+	int index = 0;
+
+	for (auto name : names)
+	{
+		Parameter* param = processor->getParameter(name);
+		ParameterEditor* editor;
+
+		if (param->getType() == Parameter::BOOLEAN_PARAM)
+			editor = new ToggleParameterEditor(param);
+		else if (param->getType() == Parameter::CATEGORICAL_PARAM)
+			editor = new ComboBoxParameterEditor(param);
+		else
+			editor = new TextBoxParameterEditor(param);
+
+		editor->setTopLeftPosition(10 + 90 * (index % numColumns), 10 + 40 * (index / numColumns));
+		addAndMakeVisible(editor);
+		parameterEditors.add(editor);
+		parameters.add(param);
+
+		++index;
+	}
+
+	setAcquisitionActive(CoreServices::getAcquisitionStatus());
+	setSize(20 + 90 * numColumns, 20 + 40 * ((index + numColumns - 1) / numColumns));
+}
+
+void PythonSettingsPanel::setAcquisitionActive(bool isActive)
+{
+	for (int i = 0; i < parameterEditors.size(); ++i)
+		parameterEditors[i]->setEnabled(!isActive || !parameters[i]->shouldDeactivateDuringAcquisition());
+}
+
+
 PythonProcessorEditor::PythonProcessorEditor(PythonProcessor* parentNode) 
     : GenericEditor(parentNode)
 {
 	// Set ptr to parent
 	pythonProcessor = parentNode;
 
-    desiredWidth = 190;
+    desiredWidth = 320;
 
 	streamSelection = std::make_unique<ComboBox>("Stream Selector");
     streamSelection->setBounds(20, 32, 155, 20);
@@ -77,10 +123,29 @@ PythonProcessorEditor::PythonProcessorEditor(PythonProcessor* parentNode)
 	addCustomParameterEditor(new ScriptPathButton(scriptPathPtr), 160, 65);
 
 	reloadButton = std::make_unique<UtilityButton>("Reload", Font(12));
-	reloadButton->setBounds(60, 95, 80, 25);
+	reloadButton->setBounds(20, 95, 75, 25);
 	reloadButton->addListener(this);
 	addAndMakeVisible(reloadButton.get());
 
+	// Everything beyond the script and stream lives in a call-out, so the editor stays narrow
+	settingsButton = std::make_unique<UtilityButton>("Settings", Font(12));
+	settingsButton->setBounds(100, 95, 75, 25);
+	settingsButton->addListener(this);
+	addAndMakeVisible(settingsButton.get());
+
+	statusLabel = std::make_unique<Label>("Status Label", "");
+	statusLabel->setFont(Font("Fira Code", "Regular", 11.0f));
+	statusLabel->setMinimumHorizontalScale(0.7f);
+	statusLabel->setBounds(185, 28, 130, 20);
+	statusLabel->setJustificationType(Justification::centredLeft);
+	addAndMakeVisible(statusLabel.get());
+
+	timingLabel = std::make_unique<Label>("Timing Label", "");
+	timingLabel->setFont(Font("Fira Code", "Regular", 10.0f));
+	timingLabel->setBounds(185, 50, 130, 75);
+	timingLabel->setJustificationType(Justification::topLeft);
+	addAndMakeVisible(timingLabel.get());
+
 }
 
 void PythonProcessorEditor::updateSettings()
@@ -116,13 +181,24 @@ void PythonProcessorEditor::updateSettings()
 void PythonProcessorEditor::startAcquisition()
 {
 	streamSelection->setEnabled(false);
-	reloadButton->setEnabled(false);
+
+	// A call-out left open keeps working, minus the settings locked during acquisition
+	if (settingsPanel != nullptr)
+		settingsPanel->setAcquisitionActive(true);
+
+	startTimer(200);
 }
 
 void PythonProcessorEditor::stopAcquisition()
 {
 	streamSelection->setEnabled(true);
-	reloadButton->setEnabled(true);
+
+	if (settingsPanel != nullptr)
+		settingsPanel->setAcquisitionActive(false);
+
+	// The final counts; the status line keeps its message
+	stopTimer();
+	timerCallback();
 }
 
 void PythonProcessorEditor::buttonClicked(Button* button)
@@ -132,6 +208,13 @@ void PythonProcessorEditor::buttonClicked(Button* button)
 	{
 		pythonProcessor->reload();
 	}
+	else if (button == settingsButton.get())
+	{
+		auto panel = std::make_unique<PythonSettingsPanel>(getProcessor());
+		settingsPanel = panel.get();
+
+		CallOutBox::launchAsynchronously(std::move(panel), settingsButton->getScreenBounds(), nullptr);
+	}
 
 }
 
@@ -154,4 +237,38 @@ void PythonProcessorEditor::setPathLabelText(String text, String tooltip)
 	scriptPathLabel->setTooltip(tooltip);
 }
 
+void PythonProcessorEditor::setStatusText(const String& text)
+{
+	statusLabel->setText(text, dontSendNotification);
+}
+
+void PythonProcessorEditor::timerCallback()
+{
+	const CallbackStats& stats = pythonProcessor->getCallbackStats();
+	StringArray lines;
+
+	// One short line per counter, to fit the editor's narrow column
+	if (pythonProcessor->isAsyncMode())
+		lines.add("Queue " + String(pythonProcessor->getNumQueuedItems()) + "/" + String(pythonProcessor->getQueueCapacity())
+				  + " drop " + String(pythonProcessor->getNumDroppedItems()));
 
+	if (pythonProcessor->isDeadlineActive())
+		lines.add("Missed " + String((int64) stats.numMissedDeadlines.load())
+				  + " skip " + String((int64) stats.numSkippedBlocks.load()));
+
+	if (stats.numLateEvents > 0 || pythonProcessor->getNumDroppedEvents() > 0)
+		lines.add("Late events " + String((int64) stats.numLateEvents.load())
+				  + " drop " + String(pythonProcessor->getNumDroppedEvents()));
+
+	if (pythonProcessor->isOutOfProcess())
+		lines.add("Restarts " + String(pythonProcessor->getNumWorkerRestarts()));
+
+	if (stats.process.getCount() > 0)
+	{
+		lines.add("p50 " + String(stats.process.getPercentile(50.0) / 1.0e6, 2)
+				  + " p99 " + String(stats.process.getPercentile(99.0) / 1.0e6, 2) + " ms");
+		lines.add("Overruns " + String((int64) stats.numOverruns.load()));
+	}
+
+	timingLabel->setText(lines.joinIntoString("\n"), dontSendNotification);
+}
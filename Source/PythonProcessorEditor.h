@@ -54,10 +54,29 @@ private:
 
 
 
+/** Advanced settings, shown in a call-out box by the editor's Settings button */
+class PythonSettingsPanel : public Component
+{
+public:
+
+	/** Constructor. Settings that cannot change during acquisition are disabled while it runs */
+	PythonSettingsPanel(GenericProcessor* processor);
+
+	/** Enables or disables the settings that cannot change during acquisition */
+	void setAcquisitionActive(bool isActive);
+
+private:
+
+	OwnedArray<ParameterEditor> parameterEditors;
+	Array<Parameter*> parameters;
+};
+
+
 class PythonProcessorEditor :
 	public GenericEditor,
 	public Button::Listener,
-	public ComboBox::Listener
+	public ComboBox::Listener,
+	public Timer
 {
 public:
 
@@ -85,6 +104,12 @@ public:
 	/** Sets the text & tooltip of the path label */
 	void setPathLabelText(String text, String tooltip);
 
+	/** Shows a message in the status line, e.g. whether Python has finished loading */
+	void setStatusText(const String& text);
+
+	/** Refreshes the queue status and callback timing during acquisition */
+	void timerCallback() override;
+
 private:
 
 	PythonProcessor* pythonProcessor;
@@ -92,7 +117,13 @@ private:
 	std::unique_ptr<Label> scriptPathLabel;
 	std::unique_ptr<Button> scriptPathButton;
 	std::unique_ptr<Button> reloadButton;
+	std::unique_ptr<Button> settingsButton;
 	std::unique_ptr<ComboBox> streamSelection;
+	std::unique_ptr<Label> statusLabel;
+	std::unique_ptr<Label> timingLabel;
+
+	/** The open call-out's panel, if any. The call-out box owns it */
+	Component::SafePointer<PythonSettingsPanel> settingsPanel;
 
 	uint16 currentStream = 0;
 
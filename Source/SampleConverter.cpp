@@ -0,0 +1,167 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "SampleConverter.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	inline uint32_t floatBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline float bitsFloat(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	inline uint16_t floatToHalf(float value)
+	{
+		const uint32_t infinity = 255u << 23;
+		const uint32_t halfOverflow = (127u + 16u) << 23;
+		const uint32_t denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+		uint32_t bits = floatBits(value);
+		const uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		// Values too small for a normal half are rounded by adding a magic number
+		const uint16_t denormal = (uint16_t) (floatBits(bitsFloat(bits) + bitsFloat(denormalMagic)) - denormalMagic);
+
+		// Normal halves: rebias the exponent, round to nearest even on the dropped mantissa bits
+		const uint32_t mantissaOdd = (bits >> 13) & 1u;
+		const uint16_t normal = (uint16_t) ((bits + ((uint32_t) (15 - 127) << 23) + 0xfffu + mantissaOdd) >> 13);
+
+		const uint16_t overflow = bits > infinity ? 0x7e00 : 0x7c00;
+
+		const uint16_t result = bits >= halfOverflow ? overflow : (bits < (113u << 23) ? denormal : normal);
+
+		return (uint16_t) (result | (sign >> 16));
+	}
+
+	inline float halfToFloat(uint16_t half)
+	{
+		const uint32_t shiftedExponent = 0x7c00u << 13;
+
+		uint32_t bits = ((uint32_t) half & 0x7fffu) << 13;
+		const uint32_t exponent = shiftedExponent & bits;
+		bits += (127u - 15u) << 23;
+
+		// Infinity / NaN keep the maximum exponent
+		const uint32_t special = bits + ((128u - 16u) << 23);
+
+		// Denormals are renormalised through a float subtraction
+		const uint32_t denormal = floatBits(bitsFloat(bits + (1u << 23)) - bitsFloat(113u << 23));
+
+		bits = exponent == shiftedExponent ? special : (exponent == 0 ? denormal : bits);
+
+		return bitsFloat(bits | (((uint32_t) half & 0x8000u) << 16));
+	}
+}
+
+SampleConverter::SampleConverter()
+	: format(FLOAT32),
+	  scale(1.0f)
+{
+}
+
+void SampleConverter::setFormat(Format format_, float int16Scale)
+{
+	format = format_;
+	scale = int16Scale > 0.0f ? int16Scale : 1.0f;
+}
+
+const char* SampleConverter::getDtypeName() const
+{
+	switch (format)
+	{
+	case FLOAT16: return "float16";
+	case INT16: return "int16";
+	default: return "float32";
+	}
+}
+
+size_t SampleConverter::getBytesPerSample() const
+{
+	return format == FLOAT32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+void SampleConverter::toPython(const float* src, void* dest, size_t numSamples) const
+{
+	if (format == FLOAT32)
+	{
+		std::memcpy(dest, src, sizeof(float) * numSamples);
+	}
+	else if (format == FLOAT16)
+	{
+		uint16_t* halves = (uint16_t*) dest;
+
+		for (size_t i = 0; i < numSamples; ++i)
+			halves[i] = floatToHalf(src[i]);
+	}
+	else
+	{
+		int16_t* integers = (int16_t*) dest;
+
+		for (size_t i = 0; i < numSamples; ++i)
+		{
+			// Divided, not multiplied by 1 / scale, which rounds differently for some samples.
+			// NaN has no integer value, so it is stored as 0 rather than converted
+			float value = src[i] / scale;
+			value = value == value ? value : 0.0f;
+			value = value < -32768.0f ? -32768.0f : value;
+			value = value > 32767.0f ? 32767.0f : value;
+			integers[i] = (int16_t) (int32_t) std::nearbyintf(value);
+		}
+	}
+}
+
+void SampleConverter::fromPython(const void* src, float* dest, size_t numSamples) const
+{
+	if (format == FLOAT32)
+	{
+		std::memcpy(dest, src, sizeof(float) * numSamples);
+	}
+	else if (format == FLOAT16)
+	{
+		const uint16_t* halves = (const uint16_t*) src;
+
+		for (size_t i = 0; i < numSamples; ++i)
+			dest[i] = halfToFloat(halves[i]);
+	}
+	else
+	{
+		const int16_t* integers = (const int16_t*) src;
+
+		for (size_t i = 0; i < numSamples; ++i)
+			dest[i] = integers[i] * scale;
+	}
+}
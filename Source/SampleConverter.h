@@ -0,0 +1,75 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SAMPLECONVERTER_H_DEFINED
+#define SAMPLECONVERTER_H_DEFINED
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+	Converts float32 samples to and from the dtype handed to Python.
+
+	float16 uses round-to-nearest-even with overflow to infinity, matching
+	numpy's astype(np.float16). int16 stores sample / scale rounded to
+	nearest even (np.rint), clipped to the int16 range; NaN is stored as 0.
+	The loops are branch-free so the compiler can
+	vectorise them.
+*/
+class SampleConverter
+{
+public:
+
+	enum Format
+	{
+		FLOAT32 = 0,
+		FLOAT16,
+		INT16
+	};
+
+	/** Constructor */
+	SampleConverter();
+
+	/** Sets the dtype and, for INT16, the value of one integer step */
+	void setFormat(Format format, float int16Scale);
+
+	Format getFormat() const { return format; }
+
+	/** Numpy dtype name of the format */
+	const char* getDtypeName() const;
+
+	size_t getBytesPerSample() const;
+
+	/** Converts float32 samples to the format */
+	void toPython(const float* src, void* dest, size_t numSamples) const;
+
+	/** Converts samples in the format back to float32 */
+	void fromPython(const void* src, float* dest, size_t numSamples) const;
+
+private:
+
+	Format format;
+	float scale;
+};
+
+#endif
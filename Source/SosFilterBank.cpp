@@ -0,0 +1,113 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "SosFilterBank.h"
+
+#include <algorithm>
+
+SosFilterBank::SosFilterBank(const double* sos, int numSections, int numChannels_)
+	: numChannels(numChannels_)
+{
+	for (int s = 0; s < numSections; ++s)
+	{
+		const double* row = sos + 6 * s;
+		const double a0 = row[3];
+
+		sections.push_back({ row[0] / a0, row[1] / a0, row[2] / a0, row[4] / a0, row[5] / a0 });
+	}
+
+	state.assign((size_t) numSections * 2 * numChannels, 0.0);
+	tile.resize((size_t) tileSamples * numChannels);
+}
+
+void SosFilterBank::process(float* data, int numSamples, ptrdiff_t channelStride)
+{
+	std::lock_guard<std::mutex> lock(processLock);
+
+	for (int start = 0; start < numSamples; start += tileSamples)
+	{
+		const int n = std::min(tileSamples, numSamples - start);
+		double* x = tile.data();
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			const float* src = data + c * channelStride + start;
+
+			for (int t = 0; t < n; ++t)
+				x[(size_t) t * numChannels + c] = src[t];
+		}
+
+		for (size_t s = 0; s < sections.size(); ++s)
+		{
+			const Section k = sections[s];
+			double* z1 = state.data() + (2 * s) * numChannels;
+			double* z2 = z1 + numChannels;
+
+			for (int t = 0; t < n; ++t)
+			{
+				double* sample = x + (size_t) t * numChannels;
+
+				for (int c = 0; c < numChannels; ++c)
+				{
+					const double in = sample[c];
+					const double out = k.b0 * in + z1[c];
+
+					z1[c] = k.b1 * in - k.a1 * out + z2[c];
+					z2[c] = k.b2 * in - k.a2 * out;
+					sample[c] = out;
+				}
+			}
+		}
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			float* dest = data + c * channelStride + start;
+
+			for (int t = 0; t < n; ++t)
+				dest[t] = (float) x[(size_t) t * numChannels + c];
+		}
+	}
+}
+
+void SosFilterBank::reset()
+{
+	std::lock_guard<std::mutex> lock(processLock);
+
+	std::fill(state.begin(), state.end(), 0.0);
+}
+
+void SosFilterBank::getState(double* dest)
+{
+	std::lock_guard<std::mutex> lock(processLock);
+
+	std::copy(state.begin(), state.end(), dest);
+}
+
+void SosFilterBank::setState(const double* src)
+{
+	std::lock_guard<std::mutex> lock(processLock);
+
+	std::copy(src, src + state.size(), state.begin());
+}
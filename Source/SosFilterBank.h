@@ -0,0 +1,86 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SOSFILTERBANK_H_DEFINED
+#define SOSFILTERBANK_H_DEFINED
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+	Cascaded second-order sections applied to every channel of a
+	(channels x samples) float32 block, keeping each channel's state
+	between blocks.
+
+	The coefficients are shared by all channels, in scipy's sos layout
+	(b0, b1, b2, a0, a1, a2 per section). Samples are filtered in double
+	precision, in tiles transposed to sample-major order so the filter
+	loops run across channels and vectorise.
+*/
+class SosFilterBank
+{
+public:
+
+	/** Constructor. sos holds numSections rows of 6 coefficients */
+	SosFilterBank(const double* sos, int numSections, int numChannels);
+
+	/** Filters a block in place. Channel i starts at data + i * channelStride */
+	void process(float* data, int numSamples, ptrdiff_t channelStride);
+
+	/** Clears the filter state of every channel */
+	void reset();
+
+	/** Copies the filter state to or from (numSections x 2 x numChannels) doubles,
+		e.g. to carry it over to a bank with new coefficients */
+	void getState(double* dest);
+	void setState(const double* src);
+
+	int getNumChannels() const { return numChannels; }
+	int getNumSections() const { return (int) sections.size(); }
+
+private:
+
+	struct Section
+	{
+		double b0, b1, b2, a1, a2;
+	};
+
+	/** Samples per channel transposed at a time */
+	static const int tileSamples = 32;
+
+	std::vector<Section> sections;
+
+	/** Transposed direct form II state, [section][2][channel] */
+	std::vector<double> state;
+
+	/** Current tile, [sample][channel] */
+	std::vector<double> tile;
+
+	int numChannels;
+
+	/** Python may call process() from several threads while the GIL is released */
+	std::mutex processLock;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "SpikeBatch.h"
+#include "PyCallbacks.h"
+
+#include <algorithm>
+#include <cstring>
+
+SpikeBatch::SpikeBatch()
+	: waveformData(nullptr),
+	  sampleNumberData(nullptr),
+	  sortedIdData(nullptr),
+	  electrodeIndexData(nullptr),
+	  capacity(0),
+	  maxChannels(0),
+	  maxSamples(0),
+	  numSpikes(0)
+{
+}
+
+float* SpikeBatch::add(int electrodeIndex, int64_t sampleNumber, uint16_t sortedId, int numChannels, int numSamples)
+{
+	// A script that kept the previous batch must not see this one written into it
+	if (numSpikes == 0 && isKept())
+	{
+		const int keptCapacity = capacity;
+		capacity = 0;
+		grow(keptCapacity, numChannels, numSamples);
+	}
+
+	if (numSpikes == capacity || numChannels > maxChannels || numSamples > maxSamples)
+		grow(numSpikes + 1, numChannels, numSamples);
+
+	sampleNumberData[numSpikes] = sampleNumber;
+	sortedIdData[numSpikes] = sortedId;
+	electrodeIndexData[numSpikes] = electrodeIndex;
+
+	float* row = waveformData + (size_t) (numSpikes++) * maxChannels * maxSamples;
+
+	// Rows are reused, so clear what a smaller electrode leaves as padding
+	if (numChannels < maxChannels || numSamples < maxSamples)
+		std::memset(row, 0, sizeof(float) * maxChannels * maxSamples);
+
+	return row;
+}
+
+void SpikeBatch::flush(const py::object& handler, const py::object& electrodes)
+{
+	if (numSpikes == 0)
+		return;
+
+	const ssize_t n = numSpikes;
+
+	// Empty the batch first so an exception in Python does not resend these spikes
+	numSpikes = 0;
+
+	// Views of the first n rows; the arrays are reused for the next block
+	py::array_t<float> waveformView({ n, (ssize_t) maxChannels, (ssize_t) maxSamples }, waveformData, waveforms);
+	py::array_t<int64_t> sampleNumberView({ n }, sampleNumberData, sampleNumbers);
+	py::array_t<uint16_t> sortedIdView({ n }, sortedIdData, sortedIds);
+	py::array_t<int32_t> electrodeIndexView({ n }, electrodeIndexData, electrodeIndices);
+
+	for (py::array* view : { (py::array*) &waveformView, (py::array*) &sampleNumberView,
+							 (py::array*) &sortedIdView, (py::array*) &electrodeIndexView })
+		view->attr("flags").attr("writeable") = false;
+
+	PyCallbacks::call(handler, waveformView, sampleNumberView, sortedIdView, electrodeIndexView, electrodes);
+}
+
+void SpikeBatch::flushEach(const py::object& handler, const py::object& electrodes)
+{
+	const int n = numSpikes;
+	numSpikes = 0;
+
+	for (int i = 0; i < n; ++i)
+	{
+		if (electrodeIndexData[i] < 0)
+			continue;
+
+		// (source_node, name, num_channels, num_samples)
+		py::tuple electrode = electrodes[py::int_(electrodeIndexData[i])];
+		const int numChannels = electrode[2].cast<int>();
+		const int numSamples = electrode[3].cast<int>();
+
+		// The unpadded waveform, as handle_spike() receives it outside a batch
+		py::array_t<float> spikeData({ (ssize_t) numChannels, (ssize_t) numSamples },
+									 { (ssize_t) (sizeof(float) * maxSamples), (ssize_t) sizeof(float) },
+									 waveformData + (size_t) i * maxChannels * maxSamples, waveforms);
+
+		PyCallbacks::call(handler, py::object(electrode[0]), py::object(electrode[1]), numChannels, numSamples,
+						  sampleNumberData[i], sortedIdData[i], spikeData);
+	}
+}
+
+void SpikeBatch::clear()
+{
+	waveforms = py::object();
+	sampleNumbers = py::object();
+	sortedIds = py::object();
+	electrodeIndices = py::object();
+
+	waveformData = nullptr;
+	sampleNumberData = nullptr;
+	sortedIdData = nullptr;
+	electrodeIndexData = nullptr;
+
+	capacity = 0;
+	maxChannels = 0;
+	maxSamples = 0;
+	numSpikes = 0;
+}
+
+bool SpikeBatch::isKept() const
+{
+	// Views handed to Python use the arrays as their base, and numpy points
+	// arrays derived from a view at the same base, so any reference beyond
+	// the batch's own means the script still holds spikes from an earlier block
+	return capacity > 0
+		&& (waveforms.ref_count() > 1 || sampleNumbers.ref_count() > 1
+			|| sortedIds.ref_count() > 1 || electrodeIndices.ref_count() > 1);
+}
+
+void SpikeBatch::grow(int minCapacity, int minChannels, int minSamples)
+{
+	const int newCapacity = std::max({ minCapacity, capacity * 2, 64 });
+	const int newChannels = std::max(minChannels, maxChannels);
+	const int newSamples = std::max(minSamples, maxSamples);
+
+	py::array_t<float> newWaveforms({ newCapacity, newChannels, newSamples });
+	py::array_t<int64_t> newSampleNumbers(newCapacity);
+	py::array_t<uint16_t> newSortedIds(newCapacity);
+	py::array_t<int32_t> newElectrodeIndices(newCapacity);
+
+	std::memset(newWaveforms.mutable_data(), 0, sizeof(float) * newWaveforms.size());
+
+	for (int i = 0; i < numSpikes; ++i)
+		for (int c = 0; c < maxChannels; ++c)
+			std::memcpy(newWaveforms.mutable_data(i, c, 0),
+						waveformData + ((size_t) i * maxChannels + c) * maxSamples,
+						sizeof(float) * maxSamples);
+
+	if (numSpikes > 0)
+	{
+		std::memcpy(newSampleNumbers.mutable_data(), sampleNumberData, sizeof(int64_t) * numSpikes);
+		std::memcpy(newSortedIds.mutable_data(), sortedIdData, sizeof(uint16_t) * numSpikes);
+		std::memcpy(newElectrodeIndices.mutable_data(), electrodeIndexData, sizeof(int32_t) * numSpikes);
+	}
+
+	waveformData = newWaveforms.mutable_data();
+	sampleNumberData = newSampleNumbers.mutable_data();
+	sortedIdData = newSortedIds.mutable_data();
+	electrodeIndexData = newElectrodeIndices.mutable_data();
+
+	waveforms = newWaveforms;
+	sampleNumbers = newSampleNumbers;
+	sortedIds = newSortedIds;
+	electrodeIndices = newElectrodeIndices;
+
+	capacity = newCapacity;
+	maxChannels = newChannels;
+	maxSamples = newSamples;
+}
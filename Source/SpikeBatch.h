@@ -0,0 +1,96 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SPIKEBATCH_H_DEFINED
+#define SPIKEBATCH_H_DEFINED
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <cstdint>
+
+namespace py = pybind11;
+
+/**
+	Spikes collected during one block, stored in preallocated numpy arrays
+	and handed to handle_spikes() in a single call.
+
+	Waveforms are (spikes x channels x samples), sized for the largest
+	electrode seen so far; smaller electrodes are zero padded. The arrays
+	only grow, so after the first few blocks adding a spike is a copy.
+	If the script keeps a batch, the next block gets fresh arrays.
+	All methods must be called with the GIL held.
+*/
+class SpikeBatch
+{
+public:
+
+	/** Constructor */
+	SpikeBatch();
+
+	/** Appends a spike and returns its waveform row, where channel i starts at i * getRowStride() */
+	float* add(int electrodeIndex, int64_t sampleNumber, uint16_t sortedId, int numChannels, int numSamples);
+
+	/** Distance between consecutive channels of a waveform row, in samples */
+	int getRowStride() const { return maxSamples; }
+
+	/** Number of spikes waiting to be delivered */
+	int size() const { return numSpikes; }
+
+	/** Calls handle_spikes(waveforms, sample_numbers, sorted_ids, electrode_indices, electrodes)
+		with read-only views of the collected spikes, then empties the batch */
+	void flush(const py::object& handler, const py::object& electrodes);
+
+	/** Calls handle_spike(source_node, electrode, num_channels, num_samples, sample_number,
+		sorted_id, spike_data) once per collected spike, for scripts without handle_spikes(),
+		then empties the batch. Spikes from electrodes missing from the table are dropped */
+	void flushEach(const py::object& handler, const py::object& electrodes);
+
+	/** Releases the arrays */
+	void clear();
+
+private:
+
+	/** Reallocates the arrays, keeping the spikes collected so far */
+	void grow(int minCapacity, int minChannels, int minSamples);
+
+	/** True if the script kept a view of the arrays after it was called */
+	bool isKept() const;
+
+	py::object waveforms;
+	py::object sampleNumbers;
+	py::object sortedIds;
+	py::object electrodeIndices;
+
+	float* waveformData;
+	int64_t* sampleNumberData;
+	uint16_t* sortedIdData;
+	int32_t* electrodeIndexData;
+
+	int capacity;
+	int maxChannels;
+	int maxSamples;
+	int numSpikes;
+};
+
+#endif
@@ -0,0 +1,351 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#include "StreamExporter.h"
+
+#if ! JUCE_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/** Segment layout, documented in StreamExporter.h */
+	const uint32 exportMagic = 0x4f455354; // "OEST"
+	const uint32 exportVersion = 1;
+	const size_t headerBytes = 4096;
+	const size_t channelNameBytes = 64;
+	const int numEventRecords = 65536;
+
+	/** Largest ring of samples and sample numbers, whatever the rate, channels and seconds */
+	const size_t maxRingBytes = (size_t) 256 << 20;
+
+	enum ExportState : uint32
+	{
+		STOPPED = 0,
+		ACQUIRING,
+		CLOSED
+	};
+
+	enum EventType : uint32
+	{
+		TTL_EVENT = 1,
+		SPIKE_EVENT
+	};
+
+	size_t alignTo64(size_t size)
+	{
+		return (size + 63) & ~(size_t) 63;
+	}
+}
+
+struct StreamExporter::Header
+{
+	uint32 magic;
+	uint32 version;
+	std::atomic<uint32> state;
+	uint32 streamId;
+	int32 numChannels;
+	int32 ringSamples;
+	double sampleRate;
+	uint64 channelNamesOffset;
+	uint64 samplesOffset;
+	uint64 sampleNumbersOffset;
+	uint64 eventsOffset;
+	int32 numEvents;
+	uint32 reserved;
+	std::atomic<uint64> blocksWritten;
+	std::atomic<uint64> samplesWritten;
+	std::atomic<uint64> samplesReserved;
+	std::atomic<uint64> eventsWritten;
+};
+
+struct StreamExporter::EventRecord
+{
+	std::atomic<uint64> sequence;
+	uint32 type;
+	int32 sourceNodeId;
+	int64 sampleNumber;
+	uint32 value;
+	uint32 state;
+	char name[32];
+};
+
+StreamExporter::StreamExporter()
+	: segment(nullptr),
+	  segmentSize(0),
+	  header(nullptr),
+	  samples(nullptr),
+	  sampleNumbers(nullptr),
+	  events(nullptr),
+	  numChannels(0),
+	  ringSamples(0),
+	  numEvents(0),
+	  blockStart(0),
+	  blockSamples(0),
+	  blockSkip(0),
+	  blockSampleNumber(0)
+{
+	static_assert (sizeof(std::atomic<uint64>) == 8 && std::atomic<uint64>::is_always_lock_free, "Counters are shared with other processes");
+	static_assert (sizeof(Header) == 104, "Header layout is documented in StreamExporter.h");
+	static_assert (sizeof(EventRecord) == 64, "Event layout is documented in StreamExporter.h");
+}
+
+StreamExporter::~StreamExporter()
+{
+	close();
+}
+
+#if ! JUCE_WINDOWS
+
+bool StreamExporter::open(const String& name, uint16 streamId, const StringArray& channelNames, double sampleRate, int ringSamples_)
+{
+	// Shared memory names cannot contain further slashes
+	const String newName = name.trim().replaceCharacter('/', '_');
+
+	if (newName.isEmpty())
+	{
+		LOGE("Shared memory export needs a name");
+		close();
+		return false;
+	}
+
+	// Many channels at a high rate would otherwise map gigabytes
+	const size_t bytesPerSample = (size_t) channelNames.size() * sizeof(float) + sizeof(int64);
+	const int maxRingSamples = (int) (maxRingBytes / bytesPerSample);
+
+	if (ringSamples_ > maxRingSamples)
+	{
+		LOGC("Shared memory export limited to ", maxRingSamples, " samples (", (int) (maxRingBytes >> 20), " MB)");
+		ringSamples_ = maxRingSamples;
+	}
+
+	const bool sameLayout = header != nullptr
+		&& newName == segmentName
+		&& header->streamId == streamId
+		&& numChannels == channelNames.size()
+		&& ringSamples == ringSamples_
+		&& header->sampleRate == sampleRate;
+
+	if (!sameLayout)
+	{
+		close();
+
+		numChannels = channelNames.size();
+		ringSamples = jmax(ringSamples_, 1);
+		numEvents = numEventRecords;
+
+		const size_t channelNamesOffset = headerBytes;
+		const size_t samplesOffset = alignTo64(channelNamesOffset + (size_t) numChannels * channelNameBytes);
+		const size_t sampleNumbersOffset = alignTo64(samplesOffset + (size_t) numChannels * ringSamples * sizeof(float));
+		const size_t eventsOffset = alignTo64(sampleNumbersOffset + (size_t) ringSamples * sizeof(int64));
+		segmentSize = eventsOffset + (size_t) numEvents * sizeof(EventRecord);
+
+		// A segment left behind by a crash would make O_EXCL fail
+		const String segmentPath = "/" + newName;
+		shm_unlink(segmentPath.toRawUTF8());
+
+		const int fd = shm_open(segmentPath.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+		if (fd < 0)
+		{
+			LOGE("Unable to create shared memory for stream export: ", strerror(errno));
+			return false;
+		}
+
+		// New pages read as zero, so every counter and event sequence starts at 0
+		if (ftruncate(fd, (off_t) segmentSize) != 0)
+		{
+			LOGE("Unable to size shared memory for stream export: ", strerror(errno));
+			::close(fd);
+			shm_unlink(segmentPath.toRawUTF8());
+			return false;
+		}
+
+		void* mapping = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if (mapping == MAP_FAILED)
+		{
+			LOGE("Unable to map shared memory for stream export: ", strerror(errno));
+			shm_unlink(segmentPath.toRawUTF8());
+			return false;
+		}
+
+		// Touches every ring page now, so the processing thread's first pass over the ring
+		// does not take a page fault per page. The pages are still zero, and no reader has
+		// seen the magic number yet
+		memset((uint8*) mapping + samplesOffset, 0, segmentSize - samplesOffset);
+
+		segmentName = newName;
+		segment = (uint8*) mapping;
+		header = (Header*) segment;
+		samples = (float*) (segment + samplesOffset);
+		sampleNumbers = (int64*) (segment + sampleNumbersOffset);
+		events = (EventRecord*) (segment + eventsOffset);
+
+		header->streamId = streamId;
+		header->numChannels = numChannels;
+		header->ringSamples = ringSamples;
+		header->sampleRate = sampleRate;
+		header->channelNamesOffset = channelNamesOffset;
+		header->samplesOffset = samplesOffset;
+		header->sampleNumbersOffset = sampleNumbersOffset;
+		header->eventsOffset = eventsOffset;
+		header->numEvents = numEvents;
+		header->version = exportVersion;
+
+		LOGC("Exporting ", numChannels, " channels to shared memory ", segmentPath,
+			 " (", (int64) (segmentSize >> 20), " MB)");
+	}
+
+	// Names may change without changing the layout
+	for (int i = 0; i < numChannels; ++i)
+	{
+		char* dest = (char*) (segment + header->channelNamesOffset + (size_t) i * channelNameBytes);
+		memset(dest, 0, channelNameBytes);
+		channelNames[i].copyToUTF8(dest, channelNameBytes - 1);
+	}
+
+	// Written last, so a reader that sees the magic number sees a complete header
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = exportMagic;
+
+	return true;
+}
+
+void StreamExporter::close()
+{
+	if (header == nullptr)
+		return;
+
+	// Readers that are still attached keep their mapping until they let go of it
+	header->state.store(CLOSED, std::memory_order_release);
+
+	munmap(segment, segmentSize);
+	shm_unlink(("/" + segmentName).toRawUTF8());
+
+	segment = nullptr;
+	header = nullptr;
+	samples = nullptr;
+	sampleNumbers = nullptr;
+	events = nullptr;
+}
+
+#else
+
+bool StreamExporter::open(const String&, uint16, const StringArray&, double, int)
+{
+	LOGE("Shared memory stream export is not supported on Windows");
+	return false;
+}
+
+void StreamExporter::close() { }
+
+#endif
+
+void StreamExporter::setAcquisitionActive(bool isActive)
+{
+	if (header != nullptr)
+		header->state.store(isActive ? ACQUIRING : STOPPED, std::memory_order_release);
+}
+
+void StreamExporter::beginBlock(int numSamples, int64 sampleNumber)
+{
+	// Only the end of a block longer than the ring is kept
+	blockStart = header->samplesWritten.load(std::memory_order_relaxed);
+	blockSamples = numSamples;
+	blockSkip = jmax(numSamples - ringSamples, 0);
+	blockSampleNumber = sampleNumber;
+
+	// Tells readers which columns are about to be overwritten
+	header->samplesReserved.store(blockStart + (uint64) numSamples, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void StreamExporter::writeChannel(int channel, const float* source)
+{
+	float* ring = samples + (size_t) channel * ringSamples;
+
+	const int numWritten = blockSamples - blockSkip;
+	const int start = (int) ((blockStart + (uint64) blockSkip) % (uint64) ringSamples);
+	const int numBeforeWrap = jmin(numWritten, ringSamples - start);
+
+	memcpy(ring + start, source + blockSkip, sizeof(float) * numBeforeWrap);
+	memcpy(ring, source + blockSkip + numBeforeWrap, sizeof(float) * (numWritten - numBeforeWrap));
+}
+
+void StreamExporter::finishBlock()
+{
+	for (int i = blockSkip; i < blockSamples; ++i)
+		sampleNumbers[(blockStart + (uint64) i) % (uint64) ringSamples] = blockSampleNumber + i;
+
+	header->samplesWritten.store(blockStart + (uint64) blockSamples, std::memory_order_release);
+	header->blocksWritten.store(header->blocksWritten.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+StreamExporter::EventRecord* StreamExporter::beginEvent(uint32 type, int sourceNodeId, int64 sampleNumber, const char* name)
+{
+	const uint64 index = header->eventsWritten.load(std::memory_order_relaxed);
+	EventRecord* record = events + index % (uint64) numEvents;
+
+	// Readers of the record's previous event see it change
+	record->sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	record->type = type;
+	record->sourceNodeId = sourceNodeId;
+	record->sampleNumber = sampleNumber;
+
+	memset(record->name, 0, sizeof(record->name));
+	strncpy(record->name, name, sizeof(record->name) - 1);
+
+	return record;
+}
+
+void StreamExporter::finishEvent(EventRecord* record)
+{
+	const uint64 index = header->eventsWritten.load(std::memory_order_relaxed);
+
+	record->sequence.store(index + 1, std::memory_order_release);
+	header->eventsWritten.store(index + 1, std::memory_order_release);
+}
+
+void StreamExporter::addTTLEvent(int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state)
+{
+	EventRecord* record = beginEvent(TTL_EVENT, sourceNodeId, sampleNumber, channelName);
+	record->value = line;
+	record->state = state ? 1 : 0;
+	finishEvent(record);
+}
+
+void StreamExporter::addSpike(int sourceNodeId, const char* electrodeName, int64 sampleNumber, uint16 sortedId, int numSpikeChannels)
+{
+	EventRecord* record = beginEvent(SPIKE_EVENT, sourceNodeId, sampleNumber, electrodeName);
+	record->value = sortedId;
+	record->state = (uint32) numSpikeChannels;
+	finishEvent(record);
+}
@@ -0,0 +1,143 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef STREAMEXPORTER_H_DEFINED
+#define STREAMEXPORTER_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+/**
+	Publishes a continuous stream, with its TTL events and spikes, into a named
+	POSIX shared memory segment that any number of local processes can map.
+	The processing thread only copies into the segment: it never waits for
+	readers, takes a lock or makes a system call, and open() faults in the
+	ring's pages beforehand.
+
+	Segment layout (little-endian, offsets in bytes):
+
+	Header
+	   0  uint32   magic, 0x4f455354 ("OEST")
+	   4  uint32   version, 1
+	   8  uint32   state: 0 = stopped, 1 = acquiring, 2 = closed (attach again)
+	  12  uint32   stream ID
+	  16  int32    number of channels, C
+	  20  int32    ring length in samples, R
+	  24  float64  sample rate
+	  32  uint64   offset of the channel names, C x 64 bytes of zero-padded UTF-8
+	  40  uint64   offset of the samples, float32 [C][R]
+	  48  uint64   offset of the sample numbers, int64 [R]
+	  56  uint64   offset of the event records
+	  64  int32    number of event records, E
+	  72  uint64   blocks written
+	  80  uint64   samples written, W
+	  88  uint64   samples being written, W' (W plus the block in progress)
+	  96  uint64   events written
+
+	The k-th sample exported is stored in column k % R, next to its sample number.
+	Columns W - R to W - 1 hold the latest samples. After copying some of them,
+	a reader reads W' again and discards the columns below W' - R, which the
+	writer may have overwritten in the meantime.
+
+	Event n is stored in record n % E, 64 bytes each:
+	   0  uint64   sequence, n + 1 once the record is complete
+	   8  uint32   type: 1 = TTL event, 2 = spike
+	  12  int32    source node ID
+	  16  int64    sample number
+	  24  uint32   TTL line, or spike sorted ID
+	  28  uint32   TTL state, or number of spike channels
+	  32  char     channel or electrode name [32], zero-padded UTF-8
+
+	A record whose sequence is not n + 1 both before and after it is copied
+	has been overwritten. Spike waveforms are not exported.
+
+	Only available on macOS and Linux.
+*/
+class StreamExporter
+{
+public:
+
+	/** Constructor */
+	StreamExporter();
+
+	/** Destructor */
+	~StreamExporter();
+
+	/** Creates the segment, or keeps the current one if its name and layout are unchanged,
+		so attached readers carry on. ringSamples is reduced to keep the ring within 256 MB.
+		Called from the message thread. */
+	bool open(const String& name, uint16 streamId, const StringArray& channelNames, double sampleRate, int ringSamples);
+
+	/** Tells readers the segment is closed, then removes it */
+	void close();
+
+	/** True if a segment is open */
+	bool isOpen() const { return header != nullptr; }
+
+	/** Number of channels exported per block */
+	int getNumChannels() const { return numChannels; }
+
+	/** Sets the state seen by readers */
+	void setAcquisitionActive(bool isActive);
+
+	/** Appends a block: beginBlock(), writeChannel() for every channel, then finishBlock() */
+	void beginBlock(int numSamples, int64 sampleNumber);
+	void writeChannel(int channel, const float* samples);
+	void finishBlock();
+
+	/** Appends an event record */
+	void addTTLEvent(int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state);
+	void addSpike(int sourceNodeId, const char* electrodeName, int64 sampleNumber, uint16 sortedId, int numSpikeChannels);
+
+private:
+
+	struct Header;
+	struct EventRecord;
+
+	/** Reserves the next event record, invalidating its previous contents */
+	EventRecord* beginEvent(uint32 type, int sourceNodeId, int64 sampleNumber, const char* name);
+
+	/** Publishes an event record */
+	void finishEvent(EventRecord* record);
+
+	String segmentName;
+	uint8* segment;
+	size_t segmentSize;
+
+	Header* header;
+	float* samples;
+	int64* sampleNumbers;
+	EventRecord* events;
+
+	int numChannels;
+	int ringSamples;
+	int numEvents;
+
+	/** Block being written, set by beginBlock() */
+	uint64 blockStart;
+	int blockSamples;
+	int blockSkip;
+	int64 blockSampleNumber;
+};
+
+#endif
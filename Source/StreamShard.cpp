@@ -0,0 +1,48 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "StreamShard.h"
+#include "PythonProcessor.h"
+
+StreamShard::StreamShard(PythonProcessor* processor_, int index)
+	: Thread("Python Stream Shard " + String(index)),
+	  pyObject(nullptr),
+	  processor(processor_)
+{
+}
+
+void StreamShard::run()
+{
+	while (!threadShouldExit())
+	{
+		if (!handoff.waitForStart(100))
+			continue;
+
+		{
+			py::gil_scoped_acquire acquire;
+			processor->processShard(*this, handoff.getBuffer());
+		}
+
+		handoff.finish();
+	}
+}
@@ -0,0 +1,94 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STREAMSHARD_H_DEFINED
+#define STREAMSHARD_H_DEFINED
+
+#include <ProcessorHeaders.h>
+#include <pybind11/pybind11.h>
+
+#include "BlockHandoff.h"
+#include "PyCallbacks.h"
+#include "SpikeBatch.h"
+#include "TTLBatch.h"
+
+namespace py = pybind11;
+
+class PythonProcessor;
+
+/** 
+	A group of data streams handled by its own PyProcessor instance on its own
+	thread. Shards share one interpreter, so their Python code only overlaps
+	where it releases the GIL.
+
+	The processing thread waits a limited time for each block. A shard that
+	misses it is abandoned: it finishes its Python call, but no longer touches
+	the AudioBuffer, and gets no new blocks until it is idle again.
+*/
+class StreamShard : public Thread
+{
+public:
+
+	/** Constructor */
+	StreamShard(PythonProcessor* processor, int index);
+
+	/** Destructor */
+	~StreamShard() { }
+
+	/** Hands the current block to the shard's thread. Returns false if the shard is
+		still busy with an abandoned block */
+	bool startBlock(AudioBuffer<float>& buffer) { return handoff.start(buffer); }
+
+	/** Waits until the shard has finished the current block. After timeoutMs the block is
+		abandoned and false is returned, unless the shard is copying to or from the buffer */
+	bool waitForBlock(int timeoutMs) { return handoff.wait(timeoutMs); }
+
+	/** Called by the shard's thread around its reads and writes of the AudioBuffer.
+		Returns false if the block was abandoned, in which case the buffer must not be touched */
+	bool beginBufferAccess() { return handoff.beginBufferAccess(); }
+	void endBufferAccess() { handoff.endBufferAccess(); }
+
+	/** Processes each block handed over by startBlock() */
+	void run() override;
+
+	/** Streams handled by this shard */
+	Array<uint16> streamIds;
+
+	/** This shard's PyProcessor instance, deleted by the processor with the GIL held */
+	py::object* pyObject;
+
+	/** Bound methods of pyObject */
+	PyCallbacks callbacks;
+
+	/** Events and spikes waiting for this shard's handle_ttl_events() / handle_spikes() */
+	TTLBatch ttlBatch;
+	SpikeBatch spikeBatch;
+
+private:
+
+	PythonProcessor* processor;
+
+	BlockHandoff handoff;
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "TTLBatch.h"
+#include "PyCallbacks.h"
+
+#include <algorithm>
+#include <cstring>
+
+TTLBatch::TTLBatch()
+	: sourceNodeData(nullptr),
+	  channelIndexData(nullptr),
+	  sampleNumberData(nullptr),
+	  lineData(nullptr),
+	  stateData(nullptr),
+	  capacity(0),
+	  numEvents(0)
+{
+}
+
+void TTLBatch::add(int sourceNodeId, int channelIndex, int64_t sampleNumber, uint8_t line, bool state)
+{
+	// A script that kept the previous batch must not see this one written into it
+	if (numEvents == 0 && isKept())
+	{
+		const int keptCapacity = capacity;
+		capacity = 0;
+		grow(keptCapacity);
+	}
+
+	if (numEvents == capacity)
+		grow(numEvents + 1);
+
+	sourceNodeData[numEvents] = sourceNodeId;
+	channelIndexData[numEvents] = channelIndex;
+	sampleNumberData[numEvents] = sampleNumber;
+	lineData[numEvents] = line;
+	stateData[numEvents] = state;
+
+	++numEvents;
+}
+
+void TTLBatch::flush(const py::object& handler, const py::object& channels)
+{
+	if (numEvents == 0)
+		return;
+
+	const ssize_t n = numEvents;
+
+	// Empty the batch first so an exception in Python does not resend these events
+	numEvents = 0;
+
+	// Views of the first n rows; the columns are reused for the next block
+	py::array_t<int32_t> sourceNodeView({ n }, sourceNodeData, sourceNodes);
+	py::array_t<int32_t> channelIndexView({ n }, channelIndexData, channelIndices);
+	py::array_t<int64_t> sampleNumberView({ n }, sampleNumberData, sampleNumbers);
+	py::array_t<uint8_t> lineView({ n }, lineData, lines);
+	py::array_t<bool> stateView({ n }, stateData, states);
+
+	for (py::array* view : { (py::array*) &sourceNodeView, (py::array*) &channelIndexView,
+							 (py::array*) &sampleNumberView, (py::array*) &lineView, (py::array*) &stateView })
+		view->attr("flags").attr("writeable") = false;
+
+	PyCallbacks::call(handler, sourceNodeView, channelIndexView, sampleNumberView, lineView, stateView, channels);
+}
+
+void TTLBatch::flushEach(const py::object& handler, const py::object& channels)
+{
+	const int n = numEvents;
+	numEvents = 0;
+
+	for (int i = 0; i < n; ++i)
+	{
+		// Channel names come from the (source_node, name) table
+		py::object channelName = channelIndexData[i] >= 0
+			? py::object(channels[py::int_(channelIndexData[i])][py::int_(1)])
+			: py::str();
+
+		PyCallbacks::call(handler, sourceNodeData[i], channelName, sampleNumberData[i], lineData[i], stateData[i]);
+	}
+}
+
+void TTLBatch::clear()
+{
+	sourceNodes = py::object();
+	channelIndices = py::object();
+	sampleNumbers = py::object();
+	lines = py::object();
+	states = py::object();
+
+	sourceNodeData = nullptr;
+	channelIndexData = nullptr;
+	sampleNumberData = nullptr;
+	lineData = nullptr;
+	stateData = nullptr;
+
+	capacity = 0;
+	numEvents = 0;
+}
+
+bool TTLBatch::isKept() const
+{
+	// Views handed to Python use the columns as their base, and numpy points
+	// arrays derived from a view at the same base
+	return capacity > 0
+		&& (sourceNodes.ref_count() > 1 || channelIndices.ref_count() > 1 || sampleNumbers.ref_count() > 1
+			|| lines.ref_count() > 1 || states.ref_count() > 1);
+}
+
+void TTLBatch::grow(int minCapacity)
+{
+	const int newCapacity = std::max({ minCapacity, capacity * 2, 256 });
+
+	py::array_t<int32_t> newSourceNodes(newCapacity);
+	py::array_t<int32_t> newChannelIndices(newCapacity);
+	py::array_t<int64_t> newSampleNumbers(newCapacity);
+	py::array_t<uint8_t> newLines(newCapacity);
+	py::array_t<bool> newStates(newCapacity);
+
+	if (numEvents > 0)
+	{
+		std::memcpy(newSourceNodes.mutable_data(), sourceNodeData, sizeof(int32_t) * numEvents);
+		std::memcpy(newChannelIndices.mutable_data(), channelIndexData, sizeof(int32_t) * numEvents);
+		std::memcpy(newSampleNumbers.mutable_data(), sampleNumberData, sizeof(int64_t) * numEvents);
+		std::memcpy(newLines.mutable_data(), lineData, sizeof(uint8_t) * numEvents);
+		std::memcpy(newStates.mutable_data(), stateData, sizeof(bool) * numEvents);
+	}
+
+	sourceNodeData = newSourceNodes.mutable_data();
+	channelIndexData = newChannelIndices.mutable_data();
+	sampleNumberData = newSampleNumbers.mutable_data();
+	lineData = newLines.mutable_data();
+	stateData = newStates.mutable_data();
+
+	sourceNodes = newSourceNodes;
+	channelIndices = newChannelIndices;
+	sampleNumbers = newSampleNumbers;
+	lines = newLines;
+	states = newStates;
+
+	capacity = newCapacity;
+}
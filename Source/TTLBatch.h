@@ -0,0 +1,90 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TTLBATCH_H_DEFINED
+#define TTLBATCH_H_DEFINED
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <cstdint>
+
+namespace py = pybind11;
+
+/**
+	TTL events collected during one block, stored as preallocated numpy
+	columns and handed to handle_ttl_events() in a single call.
+
+	The columns only grow, so after the first few blocks adding an event
+	is five stores. If the script keeps a batch, the next block gets fresh
+	columns. All methods must be called with the GIL held.
+*/
+class TTLBatch
+{
+public:
+
+	/** Constructor */
+	TTLBatch();
+
+	/** Appends an event */
+	void add(int sourceNodeId, int channelIndex, int64_t sampleNumber, uint8_t line, bool state);
+
+	/** Number of events waiting to be delivered */
+	int size() const { return numEvents; }
+
+	/** Calls handle_ttl_events(source_nodes, channel_indices, sample_numbers, lines, states, channels)
+		with read-only views of the collected events, then empties the batch */
+	void flush(const py::object& handler, const py::object& channels);
+
+	/** Calls handle_ttl_event(source_node, channel, sample_number, line, state) once per
+		collected event, for scripts without handle_ttl_events(), then empties the batch */
+	void flushEach(const py::object& handler, const py::object& channels);
+
+	/** Releases the columns */
+	void clear();
+
+private:
+
+	/** Reallocates the columns, keeping the events collected so far */
+	void grow(int minCapacity);
+
+	/** True if the script kept a view of the columns after it was called */
+	bool isKept() const;
+
+	py::object sourceNodes;
+	py::object channelIndices;
+	py::object sampleNumbers;
+	py::object lines;
+	py::object states;
+
+	int32_t* sourceNodeData;
+	int32_t* channelIndexData;
+	int64_t* sampleNumberData;
+	uint8_t* lineData;
+	bool* stateData;
+
+	int capacity;
+	int numEvents;
+};
+
+#endif
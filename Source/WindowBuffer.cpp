@@ -0,0 +1,141 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "WindowBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+WindowBuffer::WindowBuffer()
+	: numChannels(0),
+	  windowSize(0),
+	  hopSize(0),
+	  capacity(0),
+	  endSample(-1),
+	  nextWindowStart(0),
+	  writeSamples(0),
+	  writeStart(0)
+{
+}
+
+void WindowBuffer::prepare(int numChannels_, int windowSize_, int hopSize_)
+{
+	numChannels = numChannels_;
+	windowSize = windowSize_;
+	hopSize = hopSize_ > 0 ? hopSize_ : windowSize_;
+
+	capacity = 0;
+	history.clear();
+	grow(2 * windowSize);
+
+	endSample = -1;
+	nextWindowStart = 0;
+}
+
+void WindowBuffer::beginWrite(int numSamples, int64_t firstSampleNumber)
+{
+	// Windows never span a discontinuity
+	if (endSample != firstSampleNumber)
+	{
+		endSample = firstSampleNumber;
+		nextWindowStart = firstSampleNumber;
+	}
+
+	// The oldest sample still needed must survive this block
+	const int64_t oldestNeeded = std::min(nextWindowStart, endSample);
+
+	if (endSample + numSamples - oldestNeeded > capacity)
+		grow((int) (endSample + numSamples - oldestNeeded));
+
+	writeSamples = numSamples;
+	writeStart = firstSampleNumber;
+}
+
+void WindowBuffer::writeChannel(int channel, const float* data)
+{
+	float* channelHistory = history.data() + (size_t) channel * capacity;
+
+	const int position = (int) (writeStart & (capacity - 1));
+	const int firstPart = std::min(writeSamples, capacity - position);
+
+	std::memcpy(channelHistory + position, data, sizeof(float) * firstPart);
+	std::memcpy(channelHistory, data + firstPart, sizeof(float) * (writeSamples - firstPart));
+}
+
+void WindowBuffer::finishWrite()
+{
+	endSample = writeStart + writeSamples;
+}
+
+bool WindowBuffer::isWindowReady() const
+{
+	return endSample >= 0 && endSample - nextWindowStart >= windowSize;
+}
+
+int64_t WindowBuffer::readWindow(float* dest)
+{
+	const int64_t start = nextWindowStart;
+	const int position = (int) (start & (capacity - 1));
+	const int firstPart = std::min(windowSize, capacity - position);
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		const float* channelHistory = history.data() + (size_t) channel * capacity;
+		float* channelDest = dest + (size_t) channel * windowSize;
+
+		std::memcpy(channelDest, channelHistory + position, sizeof(float) * firstPart);
+		std::memcpy(channelDest + firstPart, channelHistory, sizeof(float) * (windowSize - firstPart));
+	}
+
+	nextWindowStart += hopSize;
+
+	return start;
+}
+
+void WindowBuffer::grow(int minCapacity)
+{
+	int newCapacity = std::max(capacity, 64);
+
+	while (newCapacity < minCapacity)
+		newCapacity <<= 1;
+
+	if (newCapacity == capacity)
+		return;
+
+	std::vector<float> newHistory((size_t) numChannels * newCapacity, 0.0f);
+
+	// Keep the samples a pending window may still read
+	if (endSample >= 0 && capacity > 0)
+	{
+		const int64_t keepFrom = std::max(std::min(nextWindowStart, endSample), endSample - capacity);
+
+		for (int64_t sample = keepFrom; sample < endSample; ++sample)
+			for (int channel = 0; channel < numChannels; ++channel)
+				newHistory[(size_t) channel * newCapacity + (sample & (newCapacity - 1))]
+					= history[(size_t) channel * capacity + (sample & (capacity - 1))];
+	}
+
+	history.swap(newHistory);
+	capacity = newCapacity;
+}
@@ -0,0 +1,94 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WINDOWBUFFER_H_DEFINED
+#define WINDOWBUFFER_H_DEFINED
+
+#include <cstdint>
+#include <vector>
+
+/**
+	Per-stream circular history that turns blocks of any size into
+	fixed-size windows, starting every hopSize samples.
+
+	Blocks are written with beginWrite() / writeChannel() / finishWrite(),
+	then every complete window is read with readWindow(). Sample numbers
+	are tracked so each window reports where it starts; a gap in the
+	sample numbers (e.g. acquisition restarted) clears the history.
+*/
+class WindowBuffer
+{
+public:
+
+	/** Constructor */
+	WindowBuffer();
+
+	/** Allocates the history and forgets any samples written so far. Not real-time safe. */
+	void prepare(int numChannels, int windowSize, int hopSize);
+
+	/** Starts writing a block. Grows the history if the block does not fit alongside a window. */
+	void beginWrite(int numSamples, int64_t firstSampleNumber);
+
+	/** Copies one channel of the block started with beginWrite() */
+	void writeChannel(int channel, const float* data);
+
+	/** Publishes the block written since beginWrite() */
+	void finishWrite();
+
+	/** True if a complete window is available */
+	bool isWindowReady() const;
+
+	/** Copies the next window to dest as (channels x windowSize), advances by hopSize
+		and returns the sample number of the window's first sample */
+	int64_t readWindow(float* dest);
+
+	int getNumChannels() const { return numChannels; }
+	int getWindowSize() const { return windowSize; }
+	int getHopSize() const { return hopSize; }
+
+private:
+
+	/** Reallocates the history to hold at least minCapacity samples per channel, keeping its contents */
+	void grow(int minCapacity);
+
+	std::vector<float> history;
+
+	int numChannels;
+	int windowSize;
+	int hopSize;
+
+	/** Samples per channel, always a power of two */
+	int capacity;
+
+	/** Sample number following the last sample written, or -1 before the first block */
+	int64_t endSample;
+
+	/** Sample number of the next window's first sample */
+	int64_t nextWindowStart;
+
+	/** Block being written */
+	int writeSamples;
+	int64_t writeStart;
+};
+
+#endif
@@ -0,0 +1,843 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "WorkerProcess.h"
+
+#if ! JUCE_WINDOWS
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+	/** Shared memory layout. Must match the constants in workerHostScript. */
+	const uint32 sharedMemoryMagic = 0x4f455059; // "OEPY"
+	const uint32 sharedMemoryVersion = 1;
+	const size_t outputEventsOffset = 64;
+	const int maxOutputEvents = 4096;
+	const size_t errorOffset = 32832;
+	const size_t errorSize = 4096;
+	const size_t requestOffset = 40960;
+
+	/** Room reserved per channel for continuous data, plus events and spikes */
+	const size_t maxSamplesPerBlock = 16384;
+	const size_t eventBytes = 4 * 1024 * 1024;
+
+	/** Child must construct PyProcessor within this time (imports can be slow) */
+	const int initTimeoutMs = 30000;
+
+	/** Control calls (start_acquisition etc.) */
+	const int callTimeoutMs = 5000;
+
+	enum RecordType : uint32
+	{
+		INIT_RECORD = 1,
+		CALL_RECORD,
+		BLOCK_RECORD,
+		TTL_RECORD,
+		SPIKE_RECORD
+	};
+
+	struct SharedHeader
+	{
+		uint32 magic;
+		uint32 version;
+		uint32 requestBytes;
+		uint32 status;
+		uint32 numOutputEvents;
+		uint32 reserved;
+	};
+
+	struct RecordHeader
+	{
+		uint32 type;
+		uint32 size;
+	};
+
+	struct InitRecord
+	{
+		RecordHeader header;
+		int32 numChannels;
+		float sampleRate;
+	};
+
+	struct CallRecord
+	{
+		RecordHeader header;
+		uint32 nameLength;
+		uint32 argumentLength;
+	};
+
+	struct BlockRecord
+	{
+		RecordHeader header;
+		uint32 streamId;
+		int32 numChannels;
+		int32 numSamples;
+		uint32 reserved;
+		int64 sampleNumber;
+	};
+
+	struct TTLRecord
+	{
+		RecordHeader header;
+		int32 sourceNodeId;
+		uint32 line;
+		uint32 state;
+		uint32 nameLength;
+		int64 sampleNumber;
+	};
+
+	struct SpikeRecord
+	{
+		RecordHeader header;
+		int32 sourceNodeId;
+		int32 numChannels;
+		int32 numSamples;
+		uint32 sortedId;
+		int64 sampleNumber;
+		uint32 nameLength;
+		uint32 reserved;
+	};
+
+	static_assert (sizeof(InitRecord) == 16 && sizeof(CallRecord) == 16, "Record layout must match the host script");
+	static_assert (sizeof(BlockRecord) == 32 && sizeof(TTLRecord) == 32, "Record layout must match the host script");
+	static_assert (sizeof(SpikeRecord) == 40, "Record layout must match the host script");
+	static_assert (sizeof(WorkerProcess::OutputEvent) == 8, "Output event layout must match the host script");
+
+	size_t alignTo8(size_t size)
+	{
+		return (size + 7) & ~(size_t) 7;
+	}
+
+	/** Runs in the child process: attaches to the shared memory, imports the
+		user script and executes requests until the plugin closes the socket. */
+	const char* workerHostScript = R"PY(
+import importlib, os, struct, sys, traceback, types
+from multiprocessing import shared_memory
+import numpy as np
+
+OUTPUT_EVENTS_OFFSET = 64
+MAX_OUTPUT_EVENTS = 4096
+ERROR_OFFSET = 32832
+ERROR_SIZE = 4096
+REQUEST_OFFSET = 40960
+
+INIT, CALL, BLOCK, TTL, SPIKE = 1, 2, 3, 4, 5
+
+class PythonProcessor:
+    """Stands in for the plugin's processor object inside the worker process"""
+
+    def __init__(self):
+        self.events = []
+
+    def add_python_event(self, line, state, sample_offset=0):
+        self.events.append((line, state, sample_offset))
+
+    def add_python_events(self, lines, states, sample_offsets=None):
+        if sample_offsets is None:
+            sample_offsets = [0] * len(lines)
+        self.events.extend(zip(lines, states, sample_offsets))
+
+def text(buf, offset, length):
+    return bytes(buf[offset:offset + length]).decode("utf-8", "replace")
+
+def handle_request(buf, module, processor, instance):
+    request_bytes, = struct.unpack_from("<I", buf, 8)
+    offset = REQUEST_OFFSET
+    end = REQUEST_OFFSET + request_bytes
+
+    while offset < end:
+        kind, size = struct.unpack_from("<II", buf, offset)
+
+        if kind == INIT:
+            num_channels, sample_rate = struct.unpack_from("<if", buf, offset + 8)
+            instance = module.PyProcessor(processor, num_channels, sample_rate)
+
+        elif instance is None:
+            pass
+
+        elif kind == CALL:
+            name_length, argument_length = struct.unpack_from("<II", buf, offset + 8)
+            hook = getattr(instance, text(buf, offset + 16, name_length), None)
+            if hook is not None:
+                if argument_length > 0:
+                    hook(text(buf, offset + 16 + name_length, argument_length))
+                else:
+                    hook()
+
+        elif kind == BLOCK:
+            stream_id, num_channels, num_samples, _, sample_number = struct.unpack_from("<IiiIq", buf, offset + 8)
+            data = np.frombuffer(buf, np.float32, num_channels * num_samples, offset + 32)
+            instance.process(data.reshape(num_channels, num_samples))
+
+        elif kind == TTL and hasattr(instance, "handle_ttl_event"):
+            source_node, line, state, name_length, sample_number = struct.unpack_from("<iIIIq", buf, offset + 8)
+            instance.handle_ttl_event(source_node, text(buf, offset + 32, name_length),
+                                      sample_number, line, bool(state))
+
+        elif kind == SPIKE and hasattr(instance, "handle_spike"):
+            source_node, num_channels, num_samples, sorted_id, sample_number, name_length, _ = \
+                struct.unpack_from("<iiiIqII", buf, offset + 8)
+            data_offset = offset + 40 + ((name_length + 7) & ~7)
+            spike_data = np.frombuffer(buf, np.float32, num_channels * num_samples, data_offset)
+            instance.handle_spike(source_node, text(buf, offset + 40, name_length), num_channels, num_samples,
+                                  sample_number, sorted_id, spike_data.reshape(num_channels, num_samples))
+
+        offset += size
+
+    return instance
+
+def main():
+    shm_name, script_path, fd = sys.argv[1], sys.argv[2], int(sys.argv[3])
+
+    shm = shared_memory.SharedMemory(name=shm_name)
+    try:
+        # The plugin owns the segment, so it must outlive this process
+        from multiprocessing import resource_tracker
+        resource_tracker.unregister(shm._name, "shared_memory")
+    except Exception:
+        pass
+    buf = shm.buf
+
+    api = types.ModuleType("oe_pyprocessor")
+    api.PythonProcessor = PythonProcessor
+    sys.modules["oe_pyprocessor"] = api
+
+    script_dir, file_name = os.path.split(script_path)
+    sys.path.append(script_dir)
+    module = importlib.import_module(os.path.splitext(file_name)[0])
+
+    processor = PythonProcessor()
+    instance = None
+
+    while os.read(fd, 1):
+        processor.events.clear()
+        status = 0
+
+        try:
+            instance = handle_request(buf, module, processor, instance)
+        except Exception:
+            status = 1
+            message = traceback.format_exc().encode()[:ERROR_SIZE - 1] + b"\0"
+            buf[ERROR_OFFSET:ERROR_OFFSET + len(message)] = message
+
+        events = processor.events[:MAX_OUTPUT_EVENTS]
+        for i, (line, state, sample_offset) in enumerate(events):
+            struct.pack_into("<BBxxi", buf, OUTPUT_EVENTS_OFFSET + 8 * i, int(line) & 0xFF, int(bool(state)), int(sample_offset))
+
+        struct.pack_into("<II", buf, 12, status, len(events))
+        os.write(fd, b"\1")
+
+main()
+)PY";
+}
+
+WorkerProcess::WorkerProcess()
+	: Thread("Python Worker Monitor"),
+	  numChannels(0),
+	  sampleRate(0.0f),
+	  sharedMemory(nullptr),
+	  sharedMemorySize(0),
+	  requestBytes(0),
+	  workerSocket(-1),
+	  childPid(-1),
+	  replyPending(false),
+	  replyPendingSince(0),
+	  lateReplyReady(false),
+	  lateRequestFailed(false),
+	  ready(false),
+	  needsRestart(false),
+	  acquisitionActive(false),
+	  numRestarts(0)
+{
+}
+
+WorkerProcess::~WorkerProcess()
+{
+	shutdown();
+}
+
+#if ! JUCE_WINDOWS
+
+bool WorkerProcess::launch(const String& pythonExecutable_, const String& scriptPath_, int numChannels_, float sampleRate_)
+{
+	shutdown();
+
+	pythonExecutable = pythonExecutable_;
+	scriptPath = scriptPath_;
+	numChannels = numChannels_;
+	sampleRate = sampleRate_;
+
+	static std::atomic<int> segmentCount { 0 };
+	sharedMemoryName = "oe_pyprocessor_" + String(getpid()) + "_" + String(segmentCount++);
+	sharedMemorySize = requestOffset + (size_t) jmax(numChannels, 1) * maxSamplesPerBlock * sizeof(float) + eventBytes;
+
+	const String segmentPath = "/" + sharedMemoryName;
+	const int fd = shm_open(segmentPath.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+	if (fd < 0)
+	{
+		LOGE("Unable to create shared memory for Python worker: ", strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, (off_t) sharedMemorySize) != 0)
+	{
+		LOGE("Unable to size shared memory for Python worker: ", strerror(errno));
+		close(fd);
+		shm_unlink(segmentPath.toRawUTF8());
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		LOGE("Unable to map shared memory for Python worker: ", strerror(errno));
+		shm_unlink(segmentPath.toRawUTF8());
+		return false;
+	}
+
+	sharedMemory = (uint8*) mapping;
+
+	SharedHeader* header = (SharedHeader*) sharedMemory;
+	header->magic = sharedMemoryMagic;
+	header->version = sharedMemoryVersion;
+
+	numRestarts = 0;
+	needsRestart = false;
+
+	{
+		const ScopedLock lock(requestLock);
+
+		if (!startChild())
+			return false;
+	}
+
+	startThread();
+	return true;
+}
+
+void WorkerProcess::shutdown()
+{
+	// The monitor thread may be waiting for a restarted child to initialize
+	stopThread(initTimeoutMs + 1000);
+
+	{
+		const ScopedLock lock(requestLock);
+		stopChild();
+	}
+
+	if (sharedMemory != nullptr)
+	{
+		munmap(sharedMemory, sharedMemorySize);
+		shm_unlink(("/" + sharedMemoryName).toRawUTF8());
+		sharedMemory = nullptr;
+	}
+}
+
+#if ! JUCE_MAC
+/** Closes every descriptor the GUI has open in the child, except stdio and keepFd */
+static void addCloseActions(posix_spawn_file_actions_t* actions, int keepFd)
+{
+	DIR* fds = opendir("/dev/fd");
+
+	if (fds == nullptr)
+		return;
+
+	const int listingFd = dirfd(fds);
+
+	while (dirent* entry = readdir(fds))
+	{
+		char* end;
+		const long fd = strtol(entry->d_name, &end, 10);
+
+		// Skips "." and ".."
+		if (end == entry->d_name || *end != '\0')
+			continue;
+
+		if (fd > 2 && fd != keepFd && fd != listingFd)
+			posix_spawn_file_actions_addclose(actions, (int) fd);
+	}
+
+	closedir(fds);
+}
+#endif
+
+bool WorkerProcess::startChild()
+{
+	int sockets[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+	{
+		LOGE("Unable to create socket for Python worker: ", strerror(errno));
+		return false;
+	}
+
+	// The child keeps sockets[1]; ours must not leak into it
+	fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+
+#ifdef SO_NOSIGPIPE
+	int noSigPipe = 1;
+	setsockopt(sockets[0], SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+	std::string executable = pythonExecutable.toStdString();
+	std::string script = workerHostScript;
+	std::string segment = sharedMemoryName.toStdString();
+	std::string userScript = scriptPath.toStdString();
+	std::string childSocket = std::to_string(sockets[1]);
+
+	char* argv[] = { executable.data(), (char*) "-c", script.data(), segment.data(),
+					 userScript.data(), childSocket.data(), nullptr };
+
+	// The child only inherits stdio and its socket, not the GUI's files and devices
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attributes;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawnattr_init(&attributes);
+
+#if JUCE_MAC
+	posix_spawnattr_setflags(&attributes, POSIX_SPAWN_CLOEXEC_DEFAULT);
+
+	for (int fd : { 0, 1, 2, sockets[1] })
+		posix_spawn_file_actions_addinherit_np(&actions, fd);
+#else
+	addCloseActions(&actions, sockets[1]);
+#endif
+
+	pid_t pid;
+	const int result = posix_spawn(&pid, executable.c_str(), &actions, &attributes, argv, environ);
+	close(sockets[1]);
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attributes);
+
+	if (result != 0)
+	{
+		LOGE("Unable to start Python worker ", pythonExecutable, ": ", strerror(result));
+		close(sockets[0]);
+		return false;
+	}
+
+	workerSocket = sockets[0];
+	childPid = pid;
+
+	LOGC("Started Python worker process ", childPid);
+
+	// Construct PyProcessor, and resume acquisition if the worker is being restarted
+	requestBytes = 0;
+	addInit(numChannels, sampleRate);
+
+	if (acquisitionActive)
+		addCall("start_acquisition");
+
+	if (!sendRequest(initTimeoutMs))
+	{
+		LOGE("Python worker failed to initialize");
+		stopChild();
+		return false;
+	}
+
+	ready = true;
+	return true;
+}
+
+void WorkerProcess::stopChild()
+{
+	ready = false;
+	replyPending = false;
+	lateReplyReady = false;
+
+	if (workerSocket >= 0)
+	{
+		// Closing the socket ends the child's request loop
+		close(workerSocket);
+		workerSocket = -1;
+	}
+
+	if (childPid > 0)
+	{
+		int status;
+
+		for (int i = 0; i < 20; ++i)
+		{
+			if (waitpid(childPid, &status, WNOHANG) == childPid)
+			{
+				childPid = -1;
+				return;
+			}
+
+			Thread::sleep(50);
+		}
+
+		kill(childPid, SIGKILL);
+		waitpid(childPid, &status, 0);
+		childPid = -1;
+	}
+}
+
+bool WorkerProcess::sendRequest(int timeoutMs)
+{
+	if (workerSocket < 0)
+		return false;
+
+	SharedHeader* header = (SharedHeader*) sharedMemory;
+	header->requestBytes = (uint32) requestBytes;
+	header->status = 0;
+	header->numOutputEvents = 0;
+
+	const char wake = 1;
+
+	if (send(workerSocket, &wake, 1, MSG_NOSIGNAL) != 1 || waitForReply(timeoutMs) != 1)
+	{
+		markStopped();
+		return false;
+	}
+
+	if (header->status != 0)
+	{
+		LOGE("Python Exception in worker process:\n", getLastError());
+		return false;
+	}
+
+	return true;
+}
+
+WorkerProcess::RequestResult WorkerProcess::sendBlockRequest(int deadlineMs)
+{
+	if (workerSocket < 0)
+		return REQUEST_FAILED;
+
+	SharedHeader* header = (SharedHeader*) sharedMemory;
+	header->requestBytes = (uint32) requestBytes;
+	header->status = 0;
+	header->numOutputEvents = 0;
+
+	const char wake = 1;
+	const int reply = send(workerSocket, &wake, 1, MSG_NOSIGNAL) == 1 ? waitForReply(deadlineMs) : -1;
+
+	if (reply < 0)
+	{
+		markStopped();
+		return REQUEST_FAILED;
+	}
+
+	if (reply == 0)
+	{
+		// The child still owns the shared memory until its reply arrives
+		replyPending = true;
+		replyPendingSince = Time::getMillisecondCounter();
+		return REQUEST_LATE;
+	}
+
+	if (header->status != 0)
+	{
+		LOGE("Python Exception in worker process:\n", getLastError());
+		return REQUEST_FAILED;
+	}
+
+	return REQUEST_HANDLED;
+}
+
+int WorkerProcess::waitForReply(int timeoutMs)
+{
+	pollfd response { workerSocket, POLLIN, 0 };
+	const int polled = poll(&response, 1, timeoutMs);
+
+	if (polled == 0)
+		return 0;
+
+	char done = 0;
+	return polled == 1 && recv(workerSocket, &done, 1, 0) == 1 ? 1 : -1;
+}
+
+bool WorkerProcess::collectLateReply(int timeoutMs)
+{
+	if (!replyPending)
+		return true;
+
+	const int reply = waitForReply(timeoutMs);
+
+	if (reply == 1)
+	{
+		replyPending = false;
+
+		// Its block has already passed through, so only the error and the events are kept
+		if (((SharedHeader*) sharedMemory)->status != 0)
+		{
+			LOGE("Python Exception in worker process:\n", getLastError());
+			lateRequestFailed = true;
+		}
+		else
+		{
+			lateReplyReady = true;
+		}
+
+		return true;
+	}
+
+	if (reply < 0 || (int) (Time::getMillisecondCounter() - replyPendingSince) > hangTimeoutMs)
+		markStopped();
+
+	return false;
+}
+
+void WorkerProcess::markStopped()
+{
+	// Crashed or hung: refuse requests until the monitor thread has restarted it
+	LOGE("Python worker process stopped responding");
+	ready = false;
+	needsRestart = true;
+	notify();
+}
+
+#else
+
+bool WorkerProcess::launch(const String&, const String&, int, float)
+{
+	LOGE("Running Python in a separate process is not supported on Windows");
+	return false;
+}
+
+void WorkerProcess::shutdown() { }
+
+bool WorkerProcess::startChild() { return false; }
+
+void WorkerProcess::stopChild() { }
+
+bool WorkerProcess::sendRequest(int) { return false; }
+
+WorkerProcess::RequestResult WorkerProcess::sendBlockRequest(int) { return REQUEST_FAILED; }
+
+bool WorkerProcess::collectLateReply(int) { return true; }
+
+#endif
+
+void WorkerProcess::run()
+{
+	while (!threadShouldExit())
+	{
+		if (needsRestart)
+		{
+			const ScopedLock lock(requestLock);
+
+			stopChild();
+
+			if (startChild())
+			{
+				needsRestart = false;
+				numRestarts++;
+				LOGC("Python worker process restarted");
+			}
+		}
+
+		wait(needsRestart ? 1000 : -1);
+	}
+}
+
+bool WorkerProcess::tryBeginRequest()
+{
+	if (!ready || !requestLock.tryEnter())
+		return false;
+
+	// A late request is still running: its block passes through
+	if (!ready || !collectLateReply(0))
+	{
+		requestLock.exit();
+		return false;
+	}
+
+	requestBytes = 0;
+	return true;
+}
+
+bool WorkerProcess::beginRequest()
+{
+	requestLock.enter();
+
+	if (!ready || !collectLateReply(hangTimeoutMs))
+	{
+		requestLock.exit();
+		return false;
+	}
+
+	// Only the processing thread places a late block's events
+	lateReplyReady = false;
+	requestBytes = 0;
+	return true;
+}
+
+void WorkerProcess::endRequest()
+{
+	requestLock.exit();
+}
+
+void* WorkerProcess::addRecord(uint32 type, size_t size)
+{
+	size = alignTo8(size);
+
+	if (sharedMemory == nullptr || requestOffset + requestBytes + size > sharedMemorySize)
+		return nullptr;
+
+	uint8* record = sharedMemory + requestOffset + requestBytes;
+	((RecordHeader*) record)->type = type;
+	((RecordHeader*) record)->size = (uint32) size;
+
+	requestBytes += size;
+	return record;
+}
+
+bool WorkerProcess::addInit(int numChannels_, float sampleRate_)
+{
+	numChannels = numChannels_;
+	sampleRate = sampleRate_;
+
+	InitRecord* record = (InitRecord*) addRecord(INIT_RECORD, sizeof(InitRecord));
+
+	if (record == nullptr)
+		return false;
+
+	record->numChannels = numChannels;
+	record->sampleRate = sampleRate;
+	return true;
+}
+
+bool WorkerProcess::addCall(const String& method, const String& argument)
+{
+	const size_t nameLength = method.getNumBytesAsUTF8();
+	const size_t argumentLength = argument.getNumBytesAsUTF8();
+
+	CallRecord* record = (CallRecord*) addRecord(CALL_RECORD, sizeof(CallRecord) + nameLength + argumentLength);
+
+	if (record == nullptr)
+		return false;
+
+	record->nameLength = (uint32) nameLength;
+	record->argumentLength = (uint32) argumentLength;
+
+	char* text = (char*) (record + 1);
+	memcpy(text, method.toRawUTF8(), nameLength);
+	memcpy(text + nameLength, argument.toRawUTF8(), argumentLength);
+	return true;
+}
+
+bool WorkerProcess::addTTLEvent(int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state)
+{
+	const size_t nameLength = strlen(channelName);
+
+	TTLRecord* record = (TTLRecord*) addRecord(TTL_RECORD, sizeof(TTLRecord) + nameLength);
+
+	if (record == nullptr)
+		return false;
+
+	record->sourceNodeId = sourceNodeId;
+	record->line = line;
+	record->state = state;
+	record->nameLength = (uint32) nameLength;
+	record->sampleNumber = sampleNumber;
+
+	memcpy(record + 1, channelName, nameLength);
+	return true;
+}
+
+float* WorkerProcess::addSpike(int sourceNodeId, const char* electrodeName, int numChannels_, int numSamples, int64 sampleNumber, uint16 sortedId)
+{
+	const size_t nameLength = strlen(electrodeName);
+	const size_t dataOffset = sizeof(SpikeRecord) + alignTo8(nameLength);
+
+	SpikeRecord* record = (SpikeRecord*) addRecord(SPIKE_RECORD, dataOffset + sizeof(float) * numChannels_ * numSamples);
+
+	if (record == nullptr)
+		return nullptr;
+
+	record->sourceNodeId = sourceNodeId;
+	record->numChannels = numChannels_;
+	record->numSamples = numSamples;
+	record->sortedId = sortedId;
+	record->sampleNumber = sampleNumber;
+	record->nameLength = (uint32) nameLength;
+
+	memcpy(record + 1, electrodeName, nameLength);
+	return (float*) ((uint8*) record + dataOffset);
+}
+
+float* WorkerProcess::addBlock(uint16 streamId, int numChannels_, int numSamples, int64 sampleNumber)
+{
+	BlockRecord* record = (BlockRecord*) addRecord(BLOCK_RECORD, sizeof(BlockRecord) + sizeof(float) * numChannels_ * numSamples);
+
+	if (record == nullptr)
+		return nullptr;
+
+	record->streamId = streamId;
+	record->numChannels = numChannels_;
+	record->numSamples = numSamples;
+	record->sampleNumber = sampleNumber;
+
+	return (float*) (record + 1);
+}
+
+int WorkerProcess::getNumOutputEvents() const
+{
+	return jmin((int) ((SharedHeader*) sharedMemory)->numOutputEvents, maxOutputEvents);
+}
+
+WorkerProcess::OutputEvent WorkerProcess::getOutputEvent(int index) const
+{
+	return ((const OutputEvent*) (sharedMemory + outputEventsOffset))[index];
+}
+
+String WorkerProcess::getLastError() const
+{
+	if (sharedMemory == nullptr)
+		return String();
+
+	return String::fromUTF8((const char*) sharedMemory + errorOffset,
+							(int) strnlen((const char*) sharedMemory + errorOffset, errorSize));
+}
+
+bool WorkerProcess::callMethod(const String& method, const String& argument)
+{
+	if (!beginRequest())
+		return false;
+
+	const bool success = addCall(method, argument) && sendRequest(callTimeoutMs);
+
+	endRequest();
+	return success;
+}
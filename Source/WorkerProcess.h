@@ -0,0 +1,186 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WORKERPROCESS_H_DEFINED
+#define WORKERPROCESS_H_DEFINED
+
+#include <ProcessorHeaders.h>
+#include <utility>
+
+/** 
+	Runs the Python script in a separate child process.
+
+	Each request is a sequence of records (init, method calls, TTL events,
+	spikes and continuous blocks) written into a POSIX shared memory segment.
+	Sample data is read and modified in place by the child through numpy views
+	of the segment. One byte over a socket pair wakes the child, and one byte
+	back signals completion. If the child crashes or stops responding it is
+	restarted in the background, and requests are refused until it is ready.
+
+	Only available on macOS and Linux.
+*/
+class WorkerProcess : public Thread
+{
+public:
+
+	/** TTL event emitted by the script through add_python_event() */
+	struct OutputEvent
+	{
+		uint8 line;
+		uint8 state;
+		uint16 reserved;
+		int32 sampleOffset;
+	};
+
+	/** Constructor */
+	WorkerProcess();
+
+	/** Destructor */
+	~WorkerProcess();
+
+	/** Creates the shared memory segment, starts the child process and
+		constructs the script's PyProcessor. Called from the message thread. */
+	bool launch(const String& pythonExecutable, const String& scriptPath, int numChannels, float sampleRate);
+
+	/** Stops the child process and releases the shared memory segment */
+	void shutdown();
+
+	/** True if requests are being accepted */
+	bool isReady() const { return ready; }
+
+	/** Tells the worker to call start_acquisition() again after a restart */
+	void setAcquisitionActive(bool isActive) { acquisitionActive = isActive; }
+
+	/** Starts a request from the processing thread. Returns false (without blocking)
+		if the worker is not ready or another thread is making a request. */
+	bool tryBeginRequest();
+
+	/** Starts a request, waiting for any other request to finish */
+	bool beginRequest();
+
+	/** Adds records to the current request. Return false / nullptr if there is no room. */
+	bool addInit(int numChannels, float sampleRate);
+	bool addCall(const String& method, const String& argument = String());
+	bool addTTLEvent(int sourceNodeId, const char* channelName, int64 sampleNumber, uint8 line, bool state);
+	float* addSpike(int sourceNodeId, const char* electrodeName, int numChannels, int numSamples, int64 sampleNumber, uint16 sortedId);
+	float* addBlock(uint16 streamId, int numChannels, int numSamples, int64 sampleNumber);
+
+	/** Wakes the child and waits for it to handle the current request.
+		Returns false if the script raised an exception or the child died. */
+	bool sendRequest(int timeoutMs);
+
+	/** Result of sendBlockRequest() */
+	enum RequestResult
+	{
+		REQUEST_HANDLED = 0,
+		REQUEST_FAILED,
+		REQUEST_LATE
+	};
+
+	/** Sends a request from the processing thread, waiting at most deadlineMs. A late request
+		keeps the child busy: requests are refused until its reply has been collected, and the
+		child is restarted if that takes longer than hangTimeoutMs */
+	RequestResult sendBlockRequest(int deadlineMs);
+
+	/** True once if the script raised an exception on a request that was late */
+	bool takeLateRequestFailure() { return lateRequestFailed.exchange(false); }
+
+	/** True once if tryBeginRequest() collected the reply to a late request. Its output
+		events can be read until the next request is sent */
+	bool takeLateReply() { return std::exchange(lateReplyReady, false); }
+
+	/** How long a late request may take before the child counts as hung */
+	static const int hangTimeoutMs = 1000;
+
+	/** TTL events emitted while handling the last request */
+	int getNumOutputEvents() const;
+	OutputEvent getOutputEvent(int index) const;
+
+	/** Finishes the current request */
+	void endRequest();
+
+	/** Sends a request containing a single method call */
+	bool callMethod(const String& method, const String& argument = String());
+
+	/** Python traceback from the last failed request */
+	String getLastError() const;
+
+	/** Number of times the child has been restarted since launch() */
+	int getNumRestarts() const { return numRestarts; }
+
+	/** Restarts the child process after a crash */
+	void run() override;
+
+private:
+
+	/** Starts the child process and performs the init request. requestLock must be held. */
+	bool startChild();
+
+	/** Kills the child process and closes the socket. requestLock must be held. */
+	void stopChild();
+
+	/** Reserves a record of a given type in the request area */
+	void* addRecord(uint32 type, size_t size);
+
+	/** Waits for the child's reply byte. Returns 1 if it arrived, 0 on timeout, -1 if the socket failed */
+	int waitForReply(int timeoutMs);
+
+	/** Collects the reply to a late request. Returns false if it has not arrived, restarting
+		the child if it is overdue. requestLock must be held */
+	bool collectLateReply(int timeoutMs);
+
+	/** Refuses requests until the monitor thread has restarted the child */
+	void markStopped();
+
+	String pythonExecutable;
+	String scriptPath;
+	int numChannels;
+	float sampleRate;
+
+	String sharedMemoryName;
+	uint8* sharedMemory;
+	size_t sharedMemorySize;
+	size_t requestBytes;
+
+	int workerSocket;
+	int childPid;
+
+	CriticalSection requestLock;
+
+	/** A request is still running in the child after sendBlockRequest() gave up on it.
+		requestLock must be held */
+	bool replyPending;
+	uint32 replyPendingSince;
+
+	/** The reply to a late request arrived and its output events have not been read. requestLock must be held */
+	bool lateReplyReady;
+
+	std::atomic<bool> lateRequestFailed;
+
+	std::atomic<bool> ready;
+	std::atomic<bool> needsRestart;
+	std::atomic<bool> acquisitionActive;
+	std::atomic<int> numRestarts;
+};
+
+#endif